@@ -4,6 +4,26 @@
 #include <time.h>
 #include <cstring>
 #include <stdio.h>
+#include <stdarg.h>
+#include <new>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #define MAX_NUM 70
 #define DELAY_CHANGE_T 4000     //a car changes its delay after 4-8 seconds (picked randomly)
@@ -12,7 +32,200 @@
 #define MAX_LINE_LENGTH 200
 #define PROXIMITY 2    //if the frog is this distance from a car, provided the car is neutral, it will stop
 #define INVINCIBILITY_TIME 500 //frog is immortal after getting out of a car
+#define MAX_CAR_STEPS 8        //a car can catch up with at most this many cells in one frame, the rest of the lag is dropped
 #define LEADERBOARD_FILE "leaderboard.txt"
+#define ROW_WORDS ((MAX_NUM + 63) / 64)     //number of 64-bit words needed to hold one row of the board
+#define NAV_BLOCKED 0   //results of a jump kept in the navigation table, 2 bits for each direction
+#define NAV_HALF 1
+#define NAV_FULL 2
+#define NAV_STORK (1 << 8)  //bit of a nav table cell a stork can fly through
+#define NO_SLOT -1       //slot of an empty handle
+#define MAX_FROGS 1
+#define MAX_STORKS 64               //most stork_count can be, a bigger value makes the config invalid
+#define ARENA_ALIGN 16
+#define ARENA_START_SIZE (64 * 1024)      //grows between rounds if a config needs more
+#define ALLOC_WARMUP_FRAMES 50           //compiled with -DALLOC_CHECK the game stops if it allocates after this many frames
+#define FLOW_UNREACHABLE 0xFFFF   //distance in the storks flow field of cells from which the frog can't be reached
+#define FRAME_TIME 40               //ms between two frames if no key is pressed
+#define INPUT_QUEUE_SIZE 64         //power of two
+#define INPUT_POLL_TIME 50          //ms, how often the input thread checks whether the round is over
+#define SNAPSHOT_FRESH 4            //flag next to the index of the middle snapshot, set until the renderer takes it
+#define SKIP_SIMULATION 0           //why a frame wasn't drawn: the simulation alone took the whole frame budget
+#define SKIP_DECIMATED 1            //drawing didn't fit in the budget next to the simulation, only every n-th frame is drawn
+#define SKIP_LATE 2                 //the renderer was still busy and a newer frame replaced this one
+#define SKIP_REASONS 3
+#define MAX_RENDER_EVERY 8          //at least every 8th frame is drawn, however slow it is
+#define FRAME_COST_AVERAGE 8        //frames the measured costs are averaged over
+#define OUTPUT_CURSES 0             //how frames get to the terminal, picked with the --ansi option
+#define OUTPUT_ANSI 1
+#define COLOR_PAIRS_USED 10
+#define ANSI_CELL_BYTES 24          //the most a single cell can take in the output (cursor move, colours and the character)
+#define SPRITE_MAX_WIDTH 4
+#define SPRITE_MAX_HEIGHT 2
+#define SPRITE_FROG 0               //indexes in the sprite atlas; the frog has 4 directions (U, D, R, L), cars 2 (right, left)
+#define SPRITE_HOSTILE_CAR 4
+#define SPRITE_NEUTRAL_CAR 6
+#define SPRITE_FRIENDLY_CAR 8
+#define SPRITE_CARRYING_CAR 10
+#define SPRITE_STORK 12
+#define SPRITE_ROAD 13
+#define SPRITE_GRASS 14
+#define SPRITE_OBSTACLE 15
+#define SPRITE_COUNT 16
+#define MODE_STORKS 1               //features of a level, the game loop is compiled separately for every combination of them
+#define MODE_FRIENDLY_CARS 2
+#define MODE_NEUTRAL_CARS 4
+#define MODE_ENDLESS 8
+#define GAME_MODES 16
+#define MODE_CROWD 16               //not a feature of a level: many frogs on one board, set only by the crowd mode (--crowd)
+#define NET_BUFFER 16384            //biggest message of the server, levels with more cars than fit in one frame are refused
+#define NET_HISTORY 32              //frames the server remembers for every session, a delta can be relative to any of them
+#define NET_NONE 0xFF               //sprite of an entity that is not on the board
+#define NET_LEVEL 1                 //message types
+#define NET_FRAME 2
+#define NET_KEY 3
+#define NET_ACK 4
+#define SESSION_FREE 0
+#define SESSION_RUNNING 1
+#define SESSION_CLOSING 2
+#define SESSION_KEYS 16             //power of two
+#define NET_CLIENT_MESSAGE 64       //longest message a client may send, a longer one ends its session
+#define MAX_SESSIONS 4096
+#define SERVER_REPORT_TIME 5000     //ms between two lines of the servers statistics
+#define SPECTATOR_SLOTS 8           //frames kept in the spectator ring, a viewer reading a slot has this many frames of time
+#define SPECTATOR_ENTITIES 4096     //entities of one spectator frame (a crowd has a lot of them), the rest isn't shown
+#define SPECTATOR_MAGIC 0x474F5246
+#define LEVEL_COUNT 3
+#define ENDLESS_ROAD_CHANCE 55      //% of the bands made by the endless mode that are roads, the rest is grass
+#define ENDLESS_OBSTACLE_CHANCE 40  //% of the grass rows of the endless mode with a run of obstacles
+#define RUN_BOARD_MAX_WIDTH 65535
+#define BENCH_LOOKUPS 1000000
+#define TUNE_CANDIDATES 64          //random settings the tuner starts from
+#define TUNE_NEIGHBOURS 15          //small changes of the best settings tried at the end
+#define TUNE_FIRST_GAMES 8          //games of every candidate in the first round, each next round plays twice as many
+#define TUNE_ROUND_GAMES 256        //the most games of one candidate in one round
+#define TUNE_MAX_GAMES 1024         //the most games of one candidate in one search
+#define TUNE_SURE_GAMES 128         //once the best candidate has this many games and hits both targets the search stops
+#define TUNE_WIN_TOLERANCE 0.05     //how far from the target win rate counts as a miss (loss 1)
+#define TUNE_TIME_TOLERANCE 0.1     //the same for the median time, as a part of the target
+#define MAX_CROWD 100000
+#define CROWD_BUCKET 8              //columns of one cell of the cars index
+#define CROWD_REPORT_TIME 1000      //ms between two lines of the crowds statistics
+#define EVENT_RING_SIZE 65536       //events of one thread waiting for the writer, power of two
+#define EVENT_FLUSH_TIME 50         //ms between two flushes of the event log
+#define MAX_EVENT_THREADS 64        //threads that can log events, the events of any more are dropped
+#define EVENT_LOG_MAGIC 0x474F4C46
+#define BENCH_EVENTS 10000000
+#define EVENT_JUMP 0                //types of the logged events
+#define EVENT_BLOCKED_JUMP 1
+#define EVENT_ENTER_CAR 2
+#define EVENT_LEAVE_CAR 3
+#define EVENT_LANE_CHANGE 4
+#define EVENT_CAR_HIDE 5
+#define EVENT_CAR_RESPAWN 6
+#define EVENT_DELAY_CHANGE 7
+#define EVENT_DEATH 8
+#define EVENT_SCORE 9
+#define EVENT_TYPES 10
+#define METRICS_THREADS 64          //threads that can report metrics, the metrics of any more are not counted
+#define HISTOGRAM_BUCKETS 12
+#define METRICS_BUFFER 65536        //biggest answer of the metrics endpoint
+#define METRICS_POLL_TIME 200       //ms, how often the metrics thread checks whether it should stop
+#define SCORE_QUEUE_SIZE 16         //scores waiting to be written to the leaderboard
+#define WIN_SCREEN_TIME 1000        //ms the result stays on the screen after the name is typed
+#define LOSS_SCREEN_TIME 2000
+
+//every row of the board is kept as a set of bits, one plane per kind of field
+//so checks like "is there an obstacle in these two cells" or "is there any car in this row" are a few AND operations
+//a 70 cell row still takes two words, so the three field planes are 3360 B against 4900 B of a char board[70][70],
+//and 4480 B with the car plane: the gain is in the word-wide checks, not in the memory
+typedef struct {
+    unsigned long long road[MAX_NUM][ROW_WORDS];
+    unsigned long long grass[MAX_NUM][ROW_WORDS];
+    unsigned long long obstacle[MAX_NUM][ROW_WORDS];
+    unsigned long long cars[MAX_NUM][ROW_WORDS];   //cells covered by visible cars, updated whenever a car moves
+    unsigned long long frogs[MAX_NUM][ROW_WORDS];  //crowd mode only: a bit at the x of every frog, so a car finds the frogs near it without a loop
+} BoardPlanes;
+
+//a run of equal fields in one row of a RunBoard, it lasts until the next run starts (or the row ends)
+typedef struct {
+    unsigned short start;       //first column, so a map is at most RUN_BOARD_MAX_WIDTH wide
+    char field;
+} Run;
+
+//rows [first_row, first_row of the next span) are all the same, their runs are [first_run, first_run of the next span)
+typedef struct {
+    int first_row;
+    int first_run;
+} RowSpan;
+
+//a board kept as runs of equal fields, for maps far bigger than the window (map= in the config file)
+//a row equal to the one above it shares its runs, so the memory goes with the changes on the map, not with its cells
+typedef struct {
+    int width, height;
+    RowSpan *spans;         //span_count + 1 entries, the last one only closes the board
+    int span_count, span_capacity;
+    Run *runs;
+    int run_count, run_capacity;
+} RunBoard;
+
+//all the memory of a round is carved from one block, which is reset (not freed) when the round ends
+typedef struct {
+    char *memory;
+    size_t size;
+    size_t used;
+} Arena;
+
+//reference to an entity kept in a pool, it stays valid when the entity is moved inside the pool
+//and goes stale (instead of pointing at another entity) once the entity is despawned
+typedef struct {
+    int slot;
+    int generation;
+} Handle;
+
+//entities in use take dense indexes [0, count) of their array, so loops don't skip holes
+//slots give them a stable identity; the free slots are kept in slots[count, capacity)
+typedef struct {
+    int capacity;
+    int count;
+    int *generation;    //per slot, bumped when the entity in the slot is despawned
+    int *dense;         //slot -> dense index
+    int *slots;         //dense index -> slot
+} EntityPool;
+
+//distance of every cell to the frog, shared by all the storks
+typedef struct {
+    unsigned short distance[MAX_NUM + 2][MAX_NUM + 2];
+    int frog_x, frog_y;     //frog position the field was computed for
+} FlowField;
+
+//all a client or a viewer needs to draw an entity
+typedef struct {
+    unsigned char x, y;
+    unsigned char sprite;   //NET_NONE if the entity is not on the board
+} NetEntity;
+
+typedef struct {
+    std::atomic<unsigned int> sequence;     //odd while the game is writing the slot
+    int level;                              //board the frame belongs to
+    int moves;
+    int time_elapsed;
+    int count;
+    NetEntity entities[SPECTATOR_ENTITIES];
+} SpectatorSlot;
+
+//lives in POSIX shared memory; the render thread of the game writes it, any number of viewers read it,
+//and nobody ever waits for anybody (a viewer that was too slow just tries the newest frame again)
+typedef struct {
+    int magic;
+    std::atomic<bool> open;                 //false once the game has quit
+    std::atomic<unsigned int> board_sequence;   //odd while the game is writing the board
+    int level;
+    int width, height;
+    char board[MAX_NUM * MAX_NUM];
+    std::atomic<int> newest;                //the last complete frame, -1 before the first one
+    SpectatorSlot slots[SPECTATOR_SLOTS];
+} SpectatorRing;
 
 typedef struct {
     char file_name[30];
@@ -21,16 +234,33 @@ typedef struct {
     int min_car_delay, max_car_delay;
     int width;
     int height;
-    char board[MAX_NUM][MAX_NUM];
+    BoardPlanes board;
+    unsigned short nav[MAX_NUM + 2][MAX_NUM + 2];  //for every cell of the frog, how far it gets when jumping U, D, R and L, and whether a stork can be there (see build_nav_table)
     int f_car_chance;
     int n_car_chance;
+    int output;             //OUTPUT_CURSES or OUTPUT_ANSI
+    int frame_budget;       //ms the simulation and the drawing of one frame may take together (--frame-budget)
+    unsigned int rng;       //state of game_rand(), it's part of the saved game state
+    SpectatorRing *spectators;      //NULL unless the game is started with --broadcast
+    struct ScoreWriter *scores;     //where the game hands the scores over, NULL when it runs without the terminal
+    bool endless;           //endless=1 in the config file, the board scrolls down instead of ending at the top row
+    int distance;           //rows the board has scrolled since the start of the round
+    char map_file[30];      //map=, rows an endless board scrolls through instead of making them up; empty if not given
+    RunBoard *map;          //the map, borrowed from the level cache for the round, NULL if there is none
+    char error[MAX_LINE_LENGTH];    //why the config couldn't be loaded, shown by whoever owns the terminal
+    bool stork_alive;
+    int stork_count;        //-1 if not given in the config file, then stork_alive decides whether there is one stork
+    FlowField flow;
+    EntityPool car_pool;
+    EntityPool stork_pool;
+    EntityPool frog_pool;
 } GameConfig;
 
 typedef struct {
     int x, y;
     char direction;
     int delay;
-    int last_move_time;
+    clock_t last_move_time;
     bool hidden;
     char car_type;
     //'h' - hostile car, 'n' - neutral car, 'f' - friendly car
@@ -38,19 +268,22 @@ typedef struct {
     bool carrying_frog;
     clock_t hidden_until;
     clock_t until_delay_change;
+    int prev_x, prev_y;     //position at the beginning of the current frame (used by the swept collision tests)
 } Car;
 
 typedef struct {
     int x, y;
     char direction;
     int moves;
-    int last_jump_time;
+    clock_t last_jump_time;
     int jump_delay;
+    int jump_buffer;        //ms before the end of jump_delay in which a pressed arrow is kept and used as soon as the frog can jump
     bool is_carried;
     bool is_invincible; //up to 0.5 seconds after getting out of a car the frog is "immortal" and can't die (so it can move away from the road)
     clock_t invincibility_start;
     int score;
-    Car *frogs_car;
+    Handle frogs_car;       //slot NO_SLOT when the frog walks on its own
+    int prev_x, prev_y;
 } Frog;
 
 typedef struct {
@@ -59,1148 +292,6247 @@ typedef struct {
     int delay;
     clock_t last_move_time;
     bool alive;
+    int prev_x, prev_y;
 } Stork;
 
+//beginning of a saved game state; the frogs, pools, cars, storks and lanes (and the board of an endless level) follow it in the same buffer
+typedef struct {
+    clock_t saved_at;
+    clock_t start_time;
+    unsigned int rng;
+    int car_number;
+    int stork_count;
+    int lane_capacity;
+    int road_lanes;
+    int free_lanes;
+    int distance;
+} StateHeader;
+
+//everything the renderer needs to draw one frame, copied from the simulation
+typedef struct {
+    Frog frog;
+    Car *cars;          //room for every car of the round, only the live ones are copied
+    int car_count;
+    Stork *storks;
+    int stork_count;
+    int time_elapsed;
+    BoardPlanes *board;     //the board of the level, or a copy of it if the level scrolls
+    int distance;
+    bool paused;
+} Snapshot;
+
+typedef struct {
+    char character;
+    unsigned char pair;
+} Cell;
+
+//output straight to the terminal with escape codes, only the cells that changed since the last frame are sent
+typedef struct {
+    int rows, columns;
+    Cell *front;        //what the terminal shows now
+    Cell *back;         //the frame being drawn
+    char *out;          //escape codes of one frame, sent with one write()
+    long long frames;
+    long long bytes;
+    int last_bytes;
+} AnsiScreen;
+
+//measures what a frame costs on both threads and draws fewer frames when they don't fit in the budget,
+//the simulation itself always keeps its rate, so the game time stays right on an overloaded machine
+typedef struct {
+    clock_t budget;                         //game_clock() units
+    std::atomic<clock_t> simulation_cost;   //averages, the simulation writes the first one and the renderer the second
+    clock_t render_cost;
+    std::atomic<int> render_every;          //only every n-th snapshot is drawn
+    int countdown;                          //snapshots until the next one that is drawn (the renderer only)
+    int unpublished;                        //frames since the last snapshot (the simulation only)
+    std::atomic<long long> skipped[SKIP_REASONS];
+} FrameWatchdog;
+
+//the simulation and the drawing run on different threads and pass frames through a triple buffer,
+//so a slow terminal makes the game drop frames instead of slowing it down
+typedef struct {
+    Snapshot buffers[3];
+    int back;                       //being written by the simulation
+    std::atomic<int> middle;        //the newest complete snapshot
+    int front;                      //being drawn
+    std::atomic<bool> running;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::thread drawer;
+    WINDOW *game_window;
+    GameConfig *game_config;
+    AnsiScreen ansi;
+    int board_distance;             //distance of the board the spectators have
+    FrameWatchdog watchdog;
+} Renderer;
+
+typedef struct {
+    int key;
+    clock_t time;       //when the key was read, not when the game got to it
+} KeyEvent;
+
+//keys are read by a separate thread and passed to the game through a single producer single consumer ring
+typedef struct {
+    KeyEvent events[INPUT_QUEUE_SIZE];
+    std::atomic<unsigned int> head;     //next event to take, moved only by the game
+    std::atomic<unsigned int> tail;     //next free place, moved only by the input thread
+    std::atomic<bool> running;
+    std::mutex wake_mutex;              //only for sleeping until a key comes, the ring itself doesn't lock
+    std::condition_variable wake;
+    std::thread reader;
+    bool has_buffered;                  //an arrow pressed a bit too early, waiting for the frog to be able to jump
+    KeyEvent buffered;
+} InputQueue;
+
+//every message starts with this header, then comes a NetLevel, a NetFrame or (for NET_KEY and NET_ACK) one int
+typedef struct {
+    int length;         //bytes of the whole message, the header included
+    int type;           //NET_LEVEL, NET_FRAME, NET_KEY or NET_ACK
+} NetHeader;
+
+//sent once when a client connects, followed by height * width fields of the board
+typedef struct {
+    int width, height;
+    int entity_count;
+} NetLevel;
+
+//followed by count NetDeltas
+typedef struct {
+    int frame;
+    int base;           //the frame the deltas are relative to (the last one the client acked), -1 for an empty board
+    int moves;
+    int time_elapsed;
+    int status;         //round_result() of the frame
+    int count;
+} NetFrame;
+
+typedef struct {
+    unsigned short id;      //0 is the frog, then come the car slots and the stork slots
+    NetEntity entity;
+} NetDelta;
+
+//one game hosted by the server; the network thread reads its socket, one worker does everything else
+typedef struct {
+    std::atomic<int> state;         //SESSION_FREE, SESSION_RUNNING or SESSION_CLOSING
+    int fd;
+    unsigned int generation;        //bumped every time the slot is opened, epoll events carry it next to the slot
+    GameConfig *game_config;
+    Arena arena;                    //the round, carved again every time a round ends
+    Frog *frog;
+    Car *cars;
+    Stork *storks;
+    int *cars_on_lane, *lane_directions;
+    int free_lanes;
+    clock_t start_time;
+    int mode;
+    KeyEvent keys[SESSION_KEYS];    //single producer single consumer ring, like the InputQueue
+    std::atomic<unsigned int> key_head;
+    std::atomic<unsigned int> key_tail;
+    char in[NET_CLIENT_MESSAGE];    //part of a message from the client
+    int in_length;
+    std::atomic<int> acked;         //the newest frame the client has
+    int frame;
+    NetEntity *history;             //the last NET_HISTORY frames sent
+    char *out;                      //the message being sent
+    int out_start, out_end;
+} Session;
+
+typedef struct {
+    GameConfig *level;              //every session starts from a copy of it
+    Frog level_frog;
+    int roads_pos[MAX_NUM];
+    int entity_count;
+    int max_message;
+    Session *sessions;
+    int session_count;
+    int listener;
+    int epoll;
+    int worker_count;
+    std::thread *workers;
+    std::atomic<bool> running;
+    std::atomic<long long> steps;       //since the last report
+    std::atomic<long long> step_time;   //ns
+    std::atomic<long long> bytes_sent;
+} Server;
+
+typedef struct {
+    char name[MAX_NUM];
+    int score;
+} ScoreEntry;
+
+//scores wait here for the writer thread, so the game never waits for the leaderboard file
+typedef struct ScoreWriter {
+    ScoreEntry queue[SCORE_QUEUE_SIZE];
+    int head, tail;                     //guarded by the mutex, tail - head scores are waiting
+    bool busy;                          //the writer has taken a score and is writing it
+    bool running;
+    std::mutex mutex;
+    std::condition_variable wake;       //the writer waits here for scores
+    std::condition_variable idle;       //whoever reads the leaderboard waits here until everything is written
+    std::thread writer;
+} ScoreWriter;
+
+//the end of a round is played one frame at a time like the round itself, the game loop never blocks on it
+typedef struct {
+    char result;            //'w', 'c' or 's'
+    bool typing;            //the name for the leaderboard is being typed
+    clock_t until;          //when the result screen goes away
+    char name[MAX_NUM];
+    int name_length;
+} RoundEnd;
+
+//a level as it is after parsing, never changed once it's in the cache (a newer version of the file gets a new entry)
+typedef struct {
+    char file_name[30];
+    struct timespec modified;   //mtime of the file when it was parsed
+    GameConfig level;
+    bool valid;                 //false if the file can't be played, level.error says why
+    Frog frog;
+    int roads_pos[MAX_NUM];
+    bool has_map;               //an endless level with map=, parsed together with the config
+    RunBoard map;
+    struct timespec map_modified;
+    int borrowers;              //rounds playing on the map right now, the entry isn't freed before they end
+    bool replaced;              //a newer entry took its place while it was borrowed, the last borrower frees it
+} LevelEntry;
+
+//levels parsed in the background, so starting a round doesn't have to read the file
+typedef struct {
+    LevelEntry *entries[LEVEL_COUNT];   //NULL until the level is parsed
+    std::mutex entries_mutex;           //only held to copy or borrow an entry or to swap in a new one
+    std::thread loader;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool refresh;                       //the loader should check the files again
+    std::atomic<bool> running;
+} LevelCache;
+
+//a connection to the server, for the terminal client and the load generator
+typedef struct {
+    int fd;
+    char in[NET_BUFFER];
+    int in_length;
+    int width, height, entity_count;
+    char *board;                    //height * width fields, NULL until the level comes
+    NetEntity *history;             //the last NET_HISTORY frames received
+    NetFrame last;
+    bool fresh;                     //a frame came since the last draw
+    long long frames, full_frames, bytes;
+} NetClient;
+
+//the settings of a level the tuner changes
+typedef struct {
+    int car_number;
+    int min_car_delay, max_car_delay;
+    int f_car_chance, n_car_chance;
+    int jump_delay;
+} TuneParams;
+
+typedef struct {
+    TuneParams params;
+    int games;
+    int wins;
+    int *win_times;     //ms, one for every won game
+    double loss;        //0 is right on both targets, 1 is one tolerance off
+} TuneCandidate;
+
+typedef struct {
+    int candidate;
+    unsigned int seed;
+    char result;        //round_result(), or t if the frog ran out of time
+    int time;           //ms
+} TuneGame;
+
+//shared by the threads that play the games of one round of the tuner
+typedef struct {
+    GameConfig *level;
+    Frog level_frog;
+    int roads_pos[MAX_NUM];
+    unsigned short goal_distance[MAX_NUM + 2][MAX_NUM + 2];     //what the player follows, see build_goal_distance
+    double target_win_rate;
+    int target_median;          //ms
+    int time_limit;             //ms, a game that takes longer is lost
+    TuneCandidate *candidates;
+    TuneGame *games;
+    int game_count;
+    std::atomic<int> next_game;
+} Tuner;
+
+//the live cars sorted into cells of one row and CROWD_BUCKET columns, rebuilt every frame of a crowd
+typedef struct {
+    int columns;        //cells in a row
+    int *first;         //(MAX_NUM + 2) * columns + 1 entries, the cars of cell c are order[first[c], first[c + 1])
+    int *order;         //indexes of the cars
+} CarIndex;
+
+//many frogs on one board, every one played by the same player as in the tuner
+typedef struct {
+    GameConfig *game_config;
+    Arena arena;
+    Frog *frogs;            //dense, the frog pool keeps them in [0, frog_count)
+    int frog_count;
+    Car *cars;
+    Stork *storks;
+    int roads_pos[MAX_NUM];
+    int *cars_on_lane, *lane_directions;
+    int free_lanes;
+    CarIndex index;
+    unsigned short goal_distance[MAX_NUM + 2][MAX_NUM + 2];
+    long long wins, deaths;
+} Crowd;
+
+//one gameplay event as it's written to the log file (--event-log), 16 bytes
+typedef struct {
+    unsigned int time;      //ms since the log was opened, at the frame the event happened in
+    unsigned char type;     //EVENT_*
+    char entity;            //'F' for the frog, the car type for a car
+    unsigned char thread;   //ring the event came through
+    char detail;            //direction of a jump, cause of a death ('c' or 's')
+    short x, y;
+    int value;              //moves, lane, delay, ms hidden or score, depending on the type
+} GameEvent;
+
+//written only by its own thread and read only by the writer, so neither of them ever waits
+typedef struct {
+    std::atomic<unsigned int> head;     //next event the thread writes
+    std::atomic<unsigned int> tail;     //next event the writer takes
+    std::atomic<long long> dropped;     //events that didn't fit, the writer was too slow
+    unsigned char thread;               //index of the ring in the log
+    GameEvent events[EVENT_RING_SIZE];
+} EventRing;
+
+typedef struct {
+    int magic;
+    int record_size;
+    long long dropped;      //filled in when the log is closed
+} EventLogHeader;
+
+typedef struct {
+    FILE *file;
+    clock_t start;
+    std::mutex lock;                    //taken only when a thread logs its first event
+    EventRing *rings[MAX_EVENT_THREADS];
+    std::atomic<int> ring_count;
+    std::atomic<bool> running;
+    std::thread writer;
+    long long written;
+} EventLog;
+
+//counts of observations up to every bound of histogram_bounds, the rest only counts in count
+typedef struct {
+    std::atomic<long long> buckets[HISTOGRAM_BUCKETS];
+    std::atomic<long long> count;
+    std::atomic<long long> sum;         //us
+} Histogram;
+
+//written only by its own thread, without locks or atomic read-modify-writes; the endpoint adds up all of them when it's scraped
+typedef struct {
+    std::atomic<long long> ticks;
+    Histogram frame_time;
+    Histogram score_write;
+    std::atomic<int> sessions;          //sessions the thread stepped in its last frame
+    std::atomic<int> cars_active, cars_hidden;
+    std::atomic<int> lanes;
+    std::atomic<int> lane_cars[MAX_NUM];
+} ThreadMetrics;
+
+//what one frame of a thread saw on its boards, added up over all the sessions the thread steps
+typedef struct {
+    int sessions;
+    int cars_active, cars_hidden;
+    int lanes;
+    int lane_cars[MAX_NUM];
+} CarsSample;
+
+typedef struct {
+    ThreadMetrics *threads[METRICS_THREADS];
+    std::atomic<int> thread_count;
+    std::mutex lock;                    //taken only when a thread reports for the first time
+    int listener;
+    char address[MAX_LINE_LENGTH];
+    std::atomic<bool> running;
+    std::thread endpoint;
+    char page[METRICS_BUFFER];          //the answer is put together here, so a scrape doesn't allocate
+} Metrics;
+
+//a histogram of all the threads added up
+typedef struct {
+    long long buckets[HISTOGRAM_BUCKETS];
+    long long count;
+    long long sum;
+} HistogramTotal;
+
+//set by a thread that plays games faster than real time (the tuner), game_clock() then reads it instead of the wall clock
+thread_local clock_t *simulated_clock = NULL;
+
+EventLog *event_log = NULL;             //NULL unless the game was started with --event-log
+thread_local EventRing *event_ring = NULL;
+thread_local clock_t event_clock = 0;   //time of the frame the thread is simulating, so logging an event doesn't read the clock
+
+Metrics *metrics = NULL;                //NULL unless the process was started with --metrics
+thread_local ThreadMetrics *thread_metrics = NULL;
+const long long histogram_bounds[HISTOGRAM_BUCKETS] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};     //us
+
+//wall time since the start of the program, in the same units as clock()
+//clock() counts processor time of all the threads, so it can't be used to time the game
+clock_t game_clock() {
+    if (simulated_clock != NULL) {
+        return *simulated_clock;
+    }
+    static const std::chrono::steady_clock::time_point program_start = std::chrono::steady_clock::now();
+    long long microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - program_start).count();
+    return (clock_t)(microseconds * CLOCKS_PER_SEC / 1000000);
+}
 
 void delay(int mseconds) {
-    clock_t start_time = clock();
-    while (clock() < start_time + mseconds * CLOCKS_PER_SEC / 1000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(mseconds));
 }
 
-//FILE RELATED SECTION:
-        //GETTING PARAMETERS FROM THE CONFIG FILE, PREPARING THE GAME
-FILE* open_config(GameConfig *game_config){
-    FILE *file = fopen(game_config->file_name, "r");
-    if(!file){
-        std::cerr << "There is no file with given name.\n";
+//the games own generator (same range as rand()), its state can be saved and restored with the rest of the game
+int game_rand(GameConfig *game_config){
+    game_config->rng = game_config->rng * 1103515245 + 12345;
+    return (game_config->rng >> 16) & 0x7FFF;
+}
+
+//MEMORY SECTION
+#ifdef ALLOC_CHECK
+            //counting allocator, every new made by the game is counted so the main loop can check it doesn't allocate
+//each thread has its own count, so the loaders, the writers and late registered rings don't show up in the game loop's check
+thread_local long long allocation_count = 0;
+
+void* operator new(size_t size){
+    allocation_count++;
+    void *memory = malloc(size ? size : 1);
+    if(!memory){
+        throw std::bad_alloc();
     }
-    return file;
+    return memory;
+}
+void* operator new[](size_t size){
+    return operator new(size);
+}
+//the replaced new takes its memory from malloc, so free is the right match;
+//g++ only sees a delete inlined into a free and warns about a mismatch that isn't there
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *memory) noexcept{
+    free(memory);
+}
+void operator delete[](void *memory) noexcept{
+    free(memory);
+}
+void operator delete(void *memory, size_t) noexcept{
+    free(memory);
+}
+void operator delete[](void *memory, size_t) noexcept{
+    free(memory);
 }
+#pragma GCC diagnostic pop
 
-bool parse_basic_data(char buffer[], GameConfig *game_config, Frog *frog, Stork *stork){
-    int temp;
-    if (sscanf(buffer, "jump_delay=%d", &frog->jump_delay) == 1) {
-        return true;
+//after the warm-up the number of allocations must not change anymore
+void check_frame_allocations(int frame, long long *warm_count){
+    if(frame == ALLOC_WARMUP_FRAMES){
+        *warm_count = allocation_count;
     }
-    if (sscanf(buffer, "road_lanes=%d", &game_config->road_lanes) == 1){ 
-        return true;
+    else if(frame > ALLOC_WARMUP_FRAMES && allocation_count != *warm_count){
+        endwin();
+        std::cerr << "The game loop allocated memory in frame " << frame << ".\n";
+        exit(1);
     }
-    if (sscanf(buffer, "n_car_chance=%d", &game_config->f_car_chance) == 1){
-        return true;
+}
+#endif
+
+            //ARENA
+size_t arena_aligned(size_t bytes){
+    return (bytes + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+}
+
+void init_arena(Arena *arena, size_t size){
+    arena->memory = new char[size];
+    arena->size = size;
+    arena->used = 0;
+}
+
+void free_arena(Arena *arena){
+    delete[] arena->memory;
+    arena->memory = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+void arena_reset(Arena *arena){
+    arena->used = 0;
+}
+
+//makes sure that the arena can hold this many bytes, only to be called right after a reset
+void arena_reserve(Arena *arena, size_t size){
+    if(size > arena->size){
+        free_arena(arena);
+        init_arena(arena, size);
     }
-    if (sscanf(buffer, "f_car_chance=%d", &game_config->n_car_chance) == 1){
-        return true;
+}
+
+void *arena_alloc(Arena *arena, size_t bytes){
+    bytes = arena_aligned(bytes);
+    if(arena->used + bytes > arena->size){
+        std::cerr << "The arena is too small for this round.\n";
+        abort();
     }
-    if (sscanf(buffer, "car_number=%d", &game_config->car_number) == 1){
-        return true;
+    void *memory = arena->memory + arena->used;
+    arena->used += bytes;
+    return memory;
+}
+
+//ENTITY POOLS SECTION
+            //all the memory is taken when the round starts, spawning and despawning during the game are O(1) and never allocate
+size_t pool_bytes(int capacity){
+    return 3 * arena_aligned(capacity * sizeof(int));
+}
+
+void init_pool(EntityPool *pool, int capacity, Arena *arena){
+    pool->capacity = capacity;
+    pool->count = 0;
+    pool->generation = (int*)arena_alloc(arena, capacity * sizeof(int));
+    pool->dense = (int*)arena_alloc(arena, capacity * sizeof(int));
+    pool->slots = (int*)arena_alloc(arena, capacity * sizeof(int));
+    for(int i = 0; i < capacity; i++){
+        pool->generation[i] = 0;
+        pool->dense[i] = i;
+        pool->slots[i] = i;
     }
-    if (sscanf(buffer, "width=%d", &game_config->width) == 1){ 
-        return true;
+}
+
+Handle no_handle(){
+    Handle handle;
+    handle.slot = NO_SLOT;
+    handle.generation = 0;
+    return handle;
+}
+
+Handle entity_handle(EntityPool *pool, int index){
+    Handle handle;
+    handle.slot = pool->slots[index];
+    handle.generation = pool->generation[handle.slot];
+    return handle;
+}
+
+//dense index of the entity, -1 if the handle is empty or the entity is gone
+int entity_index(EntityPool *pool, Handle handle){
+    if(handle.slot == NO_SLOT || handle.slot >= pool->capacity){
+        return -1;
     }
-    if (sscanf(buffer, "height=%d", &game_config->height) == 1){ 
-        return true;
+    if(pool->generation[handle.slot] != handle.generation){
+        return -1;
     }
-    if (sscanf(buffer, "stork_alive=%d", &temp) == 1){ 
-        if(temp == 1){
-            stork->alive = true;
-        }
-        else{
-            stork->alive = false;
-        }
-        return true;
+    return pool->dense[handle.slot];
+}
+
+//returns the dense index of the new entity, -1 if the pool is full
+int spawn_entity(EntityPool *pool){
+    if(pool->count == pool->capacity){
+        return -1;
     }
-    if (sscanf(buffer, "min_car_delay=%d", &game_config->min_car_delay) == 1) {
-        return true;
+    return pool->count++;
+}
+
+//the last entity is moved into the freed place; returns that place so the caller can move its data the same way
+int despawn_entity(EntityPool *pool, Handle handle){
+    int index = entity_index(pool, handle);
+    if(index == -1){
+        return -1;
     }
-    if (sscanf(buffer, "max_car_delay=%d", &game_config->max_car_delay) == 1) {
-        return true;
+    int last = pool->count - 1;
+    int last_slot = pool->slots[last];
+
+    pool->slots[index] = last_slot;
+    pool->dense[last_slot] = index;
+    pool->slots[last] = handle.slot;
+    pool->dense[handle.slot] = last;
+    pool->generation[handle.slot]++;
+    pool->count--;
+    return index;
+}
+
+Car *get_car(GameConfig *game_config, Car *cars, Handle handle){
+    int index = entity_index(&game_config->car_pool, handle);
+    if(index == -1){
+        return NULL;
     }
+    return &cars[index];
+}
 
-    //if nothing from above has been found 
-    return false;
+//the car data is swapped, not dropped, so a despawned car waits right after the live ones and can be spawned again
+void despawn_car(GameConfig *game_config, Car *cars, Handle handle){
+    int index = despawn_entity(&game_config->car_pool, handle);
+    if(index != -1 && index != game_config->car_pool.count){
+        Car temp = cars[index];
+        cars[index] = cars[game_config->car_pool.count];
+        cars[game_config->car_pool.count] = temp;
+    }
 }
 
-bool parse_seed(FILE *file, char buffer[], GameConfig *game_config){
-    for (int i = 0; i < game_config->height; i++) {
-        if (!fgets(buffer, MAX_LINE_LENGTH, file)) {
-            std::cerr << "Seed is too small, change height and width in the config file\n";
-            return false;
-        }
-        for (int j = 0; j < game_config->width; j++) {
-            game_config->board[i][j] = buffer[j];
-        }
+//EVENT LOG SECTION
+            //every thread that logs gets its own ring, a background writer moves the rings to the file
+EventRing *register_event_ring(){
+    std::lock_guard<std::mutex> guard(event_log->lock);
+    int count = event_log->ring_count.load(std::memory_order_relaxed);
+    if(count == MAX_EVENT_THREADS){
+        return NULL;
     }
-    return true;
+    EventRing *ring = new EventRing;
+    ring->head.store(0);
+    ring->tail.store(0);
+    ring->dropped.store(0);
+    ring->thread = count;
+    event_log->rings[count] = ring;
+    event_log->ring_count.store(count + 1, std::memory_order_release);
+    return ring;
 }
 
-bool get_data(GameConfig *game_config, Frog *frog, FILE* file, Stork *stork){
-    char buffer[MAX_LINE_LENGTH];
-    bool is_seed_found = false;
+//a few stores into the ring of the thread, the events are never waited for
+void log_event(int type, char entity, char detail, int x, int y, int value){
+    if(event_log == NULL){
+        return;
+    }
+    EventRing *ring = event_ring;
+    if(ring == NULL){
+        ring = event_ring = register_event_ring();
+        if(ring == NULL){
+            return;
+        }
+    }
+    unsigned int head = ring->head.load(std::memory_order_relaxed);
+    if(head - ring->tail.load(std::memory_order_acquire) == EVENT_RING_SIZE){
+        ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    GameEvent *event = &ring->events[head & (EVENT_RING_SIZE - 1)];
+    event->time = (unsigned int)((event_clock - event_log->start) * 1000 / CLOCKS_PER_SEC);
+    event->type = type;
+    event->entity = entity;
+    event->thread = ring->thread;
+    event->detail = detail;
+    event->x = x;
+    event->y = y;
+    event->value = value;
+    ring->head.store(head + 1, std::memory_order_release);
+}
 
-    while(fgets(buffer, MAX_LINE_LENGTH, file)){
-        if(buffer[0] == '\0' || buffer[0] == '\n'){
-            continue;
+void flush_event_ring(EventLog *log, EventRing *ring){
+    unsigned int tail = ring->tail.load(std::memory_order_relaxed);
+    unsigned int head = ring->head.load(std::memory_order_acquire);
+    while(tail != head){
+        unsigned int first = tail & (EVENT_RING_SIZE - 1);
+        unsigned int count = head - tail;
+        if(first + count > EVENT_RING_SIZE){
+            count = EVENT_RING_SIZE - first;        //the rest is at the start of the ring
         }
+        log->written += fwrite(&ring->events[first], sizeof(GameEvent), count, log->file);
+        tail += count;
+        ring->tail.store(tail, std::memory_order_release);
+    }
+}
 
-        if (parse_basic_data(buffer, game_config, frog, stork)) continue;
+void flush_event_log(EventLog *log){
+    int count = log->ring_count.load(std::memory_order_acquire);
+    for(int i = 0; i < count; i++){
+        flush_event_ring(log, log->rings[i]);
+    }
+}
 
-        if (strncmp(buffer, "seed=", 5) == 0) {
-            is_seed_found = true;
-            if (parse_seed(file, buffer, game_config) == false){
-                 return false;
-            }
-        }
+void write_events(EventLog *log){
+    while(log->running.load(std::memory_order_relaxed)){
+        std::this_thread::sleep_for(std::chrono::milliseconds(EVENT_FLUSH_TIME));
+        flush_event_log(log);
+        fflush(log->file);
     }
+}
 
-    if (is_seed_found == false) {
-        std::cerr << "No seed has been found in the given file.\n";
+bool open_event_log(const char *file_name){
+    FILE *file = fopen(file_name, "wb");
+    if(file == NULL){
         return false;
     }
+    EventLogHeader header = {EVENT_LOG_MAGIC, (int)sizeof(GameEvent), 0};
+    fwrite(&header, sizeof(header), 1, file);
+    EventLog *log = new EventLog;
+    log->file = file;
+    log->start = game_clock();
+    log->ring_count.store(0);
+    log->written = 0;
+    log->running.store(true);
+    event_log = log;
+    log->writer = std::thread(write_events, log);
     return true;
 }
-bool read_config(GameConfig *game_config, Frog *frog, Stork *stork){
-    FILE *file = open_config(game_config);
 
-    if(get_data(game_config, frog, file, stork) == false){
-        fclose(file);
-        return false;
+//only once nothing logs anymore, the rings are freed; the number of dropped events goes to the header
+void close_event_log(){
+    EventLog *log = event_log;
+    log->running.store(false);
+    log->writer.join();
+    flush_event_log(log);
+    EventLogHeader header = {EVENT_LOG_MAGIC, (int)sizeof(GameEvent), 0};
+    for(int i = 0; i < log->ring_count.load(); i++){
+        header.dropped += log->rings[i]->dropped.load();
+        delete log->rings[i];
     }
+    fseek(log->file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, log->file);
+    fclose(log->file);
+    event_log = NULL;
+    event_ring = NULL;
+    delete log;
+}
 
-    fclose(file);
-    return true;
+//METRICS SECTION
+            //every thread counts into its own block, the endpoint (--metrics) reads them all when it's scraped
+ThreadMetrics *register_thread_metrics(){
+    std::lock_guard<std::mutex> guard(metrics->lock);
+    int count = metrics->thread_count.load(std::memory_order_relaxed);
+    if(count == METRICS_THREADS){
+        return NULL;
+    }
+    ThreadMetrics *block = new ThreadMetrics();
+    metrics->threads[count] = block;
+    metrics->thread_count.store(count + 1, std::memory_order_release);
+    return block;
 }
 
-        //LEADERBOARD RELATED FUNCTIONS
-void calculate_score(int time_elapsed, Frog *frog) {
-    int base_score = 1000;            
-    int time_penalty = time_elapsed * 10; 
-    int move_penalty = frog->moves * 5;       
+//NULL if the metrics are off
+ThreadMetrics *own_metrics(){
+    if(metrics == NULL){
+        return NULL;
+    }
+    if(thread_metrics == NULL){
+        thread_metrics = register_thread_metrics();
+    }
+    return thread_metrics;
+}
 
-    frog->score = base_score - time_penalty - move_penalty;
-    if (frog->score < 0) frog->score = 0;
+//only the owner thread writes, so a load and a store are enough
+void add_metric(std::atomic<long long> *counter, long long value){
+    counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
 }
 
-void save_score(const char* player_name, int score) {
-    FILE *file = fopen(LEADERBOARD_FILE, "a");
-    if (!file) {
-        std::cerr << "Something's wrong with the leaderboard file.\n";
-        return;
+void observe(Histogram *histogram, long long microseconds){
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++){
+        if(microseconds <= histogram_bounds[i]){
+            add_metric(&histogram->buckets[i], 1);
+            break;
+        }
     }
-    fprintf(file, "%s - %d points.\n", player_name, score);
-    fclose(file);
+    add_metric(&histogram->count, 1);
+    add_metric(&histogram->sum, microseconds);
 }
 
-void print_ranking(int length, int score[], char name[][MAX_NUM], int sorted_indexes[]) {
-    int pos = 6;
-    clear();
-    mvprintw(5, 10, "___=== Game Ranking ===___");
-    for(int i = 0; i < length; i++){
-        mvprintw(pos++, 10, "%d.) %s - %d points.", i + 1, name[sorted_indexes[i]], score[sorted_indexes[i]]);
+void count_frame(long long microseconds){
+    ThreadMetrics *block = own_metrics();
+    if(block == NULL){
+        return;
     }
-    mvprintw(pos + 2, 10, "Press anything to get back to the main menu.");
-    refresh();
+    add_metric(&block->ticks, 1);
+    observe(&block->frame_time, microseconds);
 }
 
-void sort_ranking_data(int length, char name[][MAX_NUM], int score[], int sorted_indexes[]){
-    for(int i = 0; i < length; i++){
-        sorted_indexes[i] = i;
+void count_score_write(long long microseconds){
+    ThreadMetrics *block = own_metrics();
+    if(block != NULL){
+        observe(&block->score_write, microseconds);
     }
+}
 
-    for(int i = 0; i < length; i++){
-        for(int j = 1; j < length; j++){
-            if(score[sorted_indexes[j]] > score[sorted_indexes[j - 1]]){
-                int temp = sorted_indexes[j];
-                sorted_indexes[j] = sorted_indexes[j - 1];
-                sorted_indexes[j - 1] = temp;
-            }
+void sample_cars(CarsSample *sample, GameConfig *game_config, int cars_on_lane[]){
+    sample->sessions++;
+    sample->cars_active += game_config->car_pool.count;
+    sample->cars_hidden += game_config->car_number - game_config->car_pool.count;
+    if(game_config->road_lanes > sample->lanes){
+        for(int i = sample->lanes; i < game_config->road_lanes; i++){
+            sample->lane_cars[i] = 0;
         }
+        sample->lanes = game_config->road_lanes;
+    }
+    for(int i = 0; i < game_config->road_lanes; i++){
+        sample->lane_cars[i] += cars_on_lane[i];
     }
 }
 
-void show_ranking() {
-    FILE *file = fopen(LEADERBOARD_FILE, "r");
-    if (!file) {
-        std::cerr << "Something's wrong with the leaderboard file.\n";
+void init_cars_sample(CarsSample *sample){
+    sample->sessions = 0;
+    sample->cars_active = 0;
+    sample->cars_hidden = 0;
+    sample->lanes = 0;
+}
+
+void store_cars(CarsSample *sample){
+    ThreadMetrics *block = own_metrics();
+    if(block == NULL){
         return;
     }
+    block->sessions.store(sample->sessions, std::memory_order_relaxed);
+    block->cars_active.store(sample->cars_active, std::memory_order_relaxed);
+    block->cars_hidden.store(sample->cars_hidden, std::memory_order_relaxed);
+    for(int i = 0; i < sample->lanes; i++){
+        block->lane_cars[i].store(sample->lane_cars[i], std::memory_order_relaxed);
+    }
+    block->lanes.store(sample->lanes, std::memory_order_release);
+}
 
-    char name[MAX_NUM][MAX_NUM]; //creates arrays that are to be sorted based on points
-    int score[MAX_NUM];
-    int length = 0;
+//the thread has nothing running anymore, so its gauges go to zero instead of keeping the last frame
+void clear_cars(){
+    CarsSample sample;
+    init_cars_sample(&sample);
+    store_cars(&sample);
+}
 
-    //data from file will be temporarily saved here
-    char temp_name[MAX_NUM];
-    int temp_score;
-    while ((fscanf(file, "%s - %d points.", temp_name, &temp_score) == 2) && length < MAX_NUM) { 
-        strcpy(name[length], temp_name);
-        score[length] = temp_score;
-        length++;
+//BOARD BIT PLANES SECTION
+            //bits [from, from + length) of a row, cut to the size of the plane
+unsigned long long span_mask(int word, int from, int length){
+    int first = word * 64;
+    int start = from > first ? from - first : 0;
+    int end = from + length < first + 64 ? from + length - first : 64;
+    if(start >= end){
+        return 0;
     }
+    unsigned long long mask = (end - start == 64) ? ~0ULL : ((1ULL << (end - start)) - 1);
+    return mask << start;
+}
 
-    int *sorted_indexes = new int[length];
-    sort_ranking_data(length, name, score, sorted_indexes);
-    print_ranking(length, score, name, sorted_indexes);
-    delete[] sorted_indexes;
-   
-    fclose(file);
+bool any_bits(const unsigned long long row[], int from, int length){
+    for(int w = 0; w < ROW_WORDS; w++){
+        if(row[w] & span_mask(w, from, length)){
+            return true;
+        }
+    }
+    return false;
 }
 
-void get_player_name(Frog *frog, char name[]) {
-    mvprintw(3, 3, "Congratulations! You got: %d points.", frog->score);
-    mvprintw(4, 5, "Enter your name:");
-    echo();
-    getnstr(name, MAX_NUM - 1); 
-    noecho();
+void set_bits(unsigned long long row[], int from, int length){
+    for(int w = 0; w < ROW_WORDS; w++){
+        row[w] |= span_mask(w, from, length);
+    }
 }
 
-//INITIALIZING THE STORK
-void init_stork(GameConfig *game_config, Stork *stork, Frog *frog){
-    if(stork->alive == true){
-        stork->x = rand() % (game_config->width / 2) + 1;
-        stork->y = rand() % (game_config->height / 2) + game_config->height / 2;
-        stork->delay = frog->jump_delay * 2;
-        stork->last_move_time = clock();
-        stork->dir_x = 1; 
-        stork->dir_y = 1;
+void clear_bits(unsigned long long row[], int from, int length){
+    for(int w = 0; w < ROW_WORDS; w++){
+        row[w] &= ~span_mask(w, from, length);
     }
 }
-//dir_x = -1; storks x position is decreasing
-//dir_x = 0; storks x position is not changing
-//dir_x = 1; storks x position is increasing
-//same with dir_y
-
-void check_whether_in_board(GameConfig *game_config, Stork *stork);
-void set_storks_direction(Stork *stork, Frog *frog);
-
-void move_stork(GameConfig *game_config, Stork *stork, Frog *frog) {
-    if(stork->alive == true){
-        if ((clock() - stork->last_move_time) * 1000 / CLOCKS_PER_SEC < stork->delay) {
-            return; 
-        }
-        if(frog->frogs_car == NULL){
-            set_storks_direction(stork, frog);
 
-            stork->x += stork->dir_x;
-            stork->y += stork->dir_y;
-
-            check_whether_in_board(game_config, stork);
-            stork->last_move_time = clock();
+bool is_row_clear(const unsigned long long row[]){
+    for(int w = 0; w < ROW_WORDS; w++){
+        if(row[w] != 0){
+            return false;
         }
     }
+    return true;
 }
 
-void set_storks_direction(Stork *stork, Frog *frog){
-    if (frog->x > stork->x) {
-        stork->dir_x = 1;
-    } else if (frog->x < stork->x) {
-        stork->dir_x = -1;
-    } else {
-        stork->dir_x = 0;
+//x and y are the coordinates in the game window, which is shifted by one from the board because of the frame
+bool is_obstacle(GameConfig *game_config, int y, int x, int length){
+    if(y < 1 || y > MAX_NUM){
+        return false;
     }
+    return any_bits(game_config->board.obstacle[y - 1], x - 1, length);
+}
 
-    if (frog->y > stork->y) {
-        stork->dir_y = 1;
-    } else if (frog->y < stork->y) {
-        stork->dir_y = -1;
-    } else {
-        stork->dir_y = 0;
+char plane_field(BoardPlanes *board, int row, int column){
+    if(any_bits(board->road[row], column, 1)){
+        return 'R';
     }
+    if(any_bits(board->grass[row], column, 1)){
+        return 'G';
+    }
+    if(any_bits(board->obstacle[row], column, 1)){
+        return 'O';
+    }
+    return ' ';
 }
 
-bool check_stork_collision(Frog *frog, Stork *stork) {
-    if((frog->x == stork->x || frog->x + 1 == stork->x )&& frog->y == stork->y){
-        return true;
+char board_field(GameConfig *game_config, int row, int column){
+    return plane_field(&game_config->board, row, column);
+}
+
+void set_board_field(GameConfig *game_config, int row, int column, char field){
+    if(field == 'R'){
+        set_bits(game_config->board.road[row], column, 1);
     }
-    else{
-        return false;
+    else if(field == 'G'){
+        set_bits(game_config->board.grass[row], column, 1);
+    }
+    else if(field == 'O'){
+        set_bits(game_config->board.obstacle[row], column, 1);
     }
 }
 
-void check_whether_in_board(GameConfig *game_config, Stork *stork){
-    if (stork->x <= 1) stork->x = 1;
-    if (stork->x >= game_config->width) stork->x = game_config->width;
-    if (stork->y <= 1) stork->y = 1;
-    if (stork->y >= game_config->height) stork->y = game_config->height;
+            //RUN BOARD - ROWS STORED AS RUNS OF EQUAL FIELDS
+void init_run_board(RunBoard *board, int width){
+    board->width = width;
+    board->height = 0;
+    board->span_capacity = 64;
+    board->spans = new RowSpan[board->span_capacity];
+    board->span_count = 0;
+    board->run_capacity = 256;
+    board->runs = new Run[board->run_capacity];
+    board->run_count = 0;
+    board->spans[0].first_row = 0;
+    board->spans[0].first_run = 0;
 }
 
-
-// INITIALIZING THE FROG
-void init_frog(GameConfig* game_config, Frog* frog) {
-    frog->x = game_config->width / 2 + 1;
-    frog->y = game_config->height;
-    frog->direction = 'U';                  // Initial frog's direction (upwards)
-    frog->moves = 0;
-    frog->last_jump_time = clock();
-    frog->is_carried = false;
-    frog->score = 0;
-    frog->frogs_car = NULL;
+void free_run_board(RunBoard *board){
+    delete[] board->spans;
+    delete[] board->runs;
 }
 
-// INITIALIZING AND RANDOMIZING CARS
+void resize_runs(RunBoard *board, int capacity){
+    Run *runs = new Run[capacity];
+    memcpy(runs, board->runs, board->run_count * sizeof(Run));
+    delete[] board->runs;
+    board->runs = runs;
+    board->run_capacity = capacity;
+}
 
-void change_car_position(Car* car, GameConfig* game_config, int roads_pos[], int cars_on_lane[], int* free_lanes, int lane_direction[]) {
-    int lane = -1;
+void resize_spans(RunBoard *board, int capacity){
+    RowSpan *spans = new RowSpan[capacity];
+    memcpy(spans, board->spans, (board->span_count + 1) * sizeof(RowSpan));
+    delete[] board->spans;
+    board->spans = spans;
+    board->span_capacity = capacity;
+}
 
-    // Find an empty lane if exists
-    for (int i = 0; i < game_config->road_lanes; i++) {
-        if (cars_on_lane[i] == 0) {
-            lane = i;
-            break;
-        }
+void grow_runs(RunBoard *board, int needed){
+    if(needed > board->run_capacity){
+        resize_runs(board, board->run_capacity * 2 > needed ? board->run_capacity * 2 : needed);
     }
+}
 
-    // If there is none empty lanes pick random one
-    if (lane == -1) {
-        lane = rand() % game_config->road_lanes;
-    } 
-    else if(cars_on_lane[lane] == 0) {
-        (*free_lanes)--; 
+void grow_spans(RunBoard *board, int needed){
+    if(needed > board->span_capacity){
+        resize_spans(board, board->span_capacity * 2 > needed ? board->span_capacity * 2 : needed);
     }
-
-    car->y = roads_pos[lane] + 1;
-    car->direction = lane_direction[lane];
-    cars_on_lane[lane]++;
 }
 
-void set_cars_type(Car *car, GameConfig *game_config){
-    int temp = ((rand() % 100) * 7937) % 100;
-        if(temp < game_config->f_car_chance){
-            car->car_type = 'f';
-        }
-        else if(temp < (game_config->f_car_chance + game_config->n_car_chance)){
-            car->car_type = 'n';
-        }
-        else{
-            car->car_type = 'h';
-        }
+//once the board is complete the room left for more rows is given back
+void trim_run_board(RunBoard *board){
+    resize_runs(board, board->run_count > 0 ? board->run_count : 1);
+    resize_spans(board, board->span_count + 1);
 }
-void init_cars(Car *cars, GameConfig *game_config, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
-    for(int i = 0; i < game_config->car_number; i++){
-        cars[i].x = (rand() % (game_config->width - 2)) + 2;
-        cars[i].delay = (rand() % (game_config->max_car_delay - game_config->min_car_delay)) + game_config->min_car_delay;
-        cars[i].last_move_time = clock();
-        cars[i].hidden = false;
-        cars[i].hidden_until = 0;
-        cars[i].until_delay_change = ((rand() % DELAY_CHANGE_T) + DELAY_CHANGE_T) * CLOCKS_PER_SEC / 1000;
-        set_cars_type(&cars[i], game_config);
-        cars[i].carrying_frog = false;
 
-        change_car_position(&cars[i], game_config, roads_pos, cars_on_lane, free_lanes, lane_directions);
+bool same_runs(RunBoard *board, int first, int second, int count){
+    for(int i = 0; i < count; i++){
+        if(board->runs[first + i].start != board->runs[second + i].start || board->runs[first + i].field != board->runs[second + i].field){
+            return false;
+        }
     }
-}
-
-//INITIALIZING THE GAME
-
-bool start_game() {
-    initscr();             
-    cbreak();              
-    noecho();               
-    keypad(stdscr, TRUE);   
-    curs_set(0);            
-    nodelay(stdscr, TRUE);
-    srand(time(NULL));
-
-    start_color();
-    init_pair(1, 23, 23);           //colour for grass
-    init_pair(2, 8, 8);             //colour for roads
-    init_pair(3, COLOR_YELLOW, 10); //the frog
-    init_pair(4, COLOR_WHITE, COLOR_BLACK);     //status bar
-    init_pair(5, COLOR_YELLOW, 12);             //colour for hostile cars 
-    init_pair(6, 10, 21);                       //obstacles
-    init_pair(7, COLOR_BLACK, 14);              //neutral cars
-    init_pair(8, COLOR_YELLOW, 11);             //friendly cars
-    init_pair(9, COLOR_BLACK, COLOR_WHITE);       //stork
-
     return true;
 }
 
-// DRAWING SECTION - STATUS, BOARD, FROG, CARS, STORK
+//adds a row at the bottom of the board; fields after the end of the line are empty
+void append_run_row(RunBoard *board, const char line[]){
+    grow_runs(board, board->run_count + board->width);
+    grow_spans(board, board->span_count + 2);
+    int first = board->run_count;
+    bool line_ended = false;
+    for(int column = 0; column < board->width; column++){
+        if(line[column] == '\0' || line[column] == '\n'){
+            line_ended = true;
+        }
+        char field = line_ended ? ' ' : line[column];
+        if(board->run_count == first || board->runs[board->run_count - 1].field != field){
+            board->runs[board->run_count].start = column;
+            board->runs[board->run_count].field = field;
+            board->run_count++;
+        }
+    }
 
-void draw_status(GameConfig* game_config, Frog* frog, int time_elapsed) {
-    attron(COLOR_PAIR(4));
-    mvprintw(game_config->height + 2, 0, "Jakub Sledzik | ID: 203221 | Ruchy: %d | Czas: %ds", frog->moves, time_elapsed);
-    attroff(COLOR_PAIR(4));
+    //the same row as the one above only makes the span longer
+    int last_first = board->span_count > 0 ? board->spans[board->span_count - 1].first_run : 0;
+    if(board->span_count > 0 && first - last_first == board->run_count - first && same_runs(board, last_first, first, first - last_first)){
+        board->run_count = first;
+    }
+    else{
+        board->spans[board->span_count].first_row = board->height;
+        board->spans[board->span_count].first_run = first;
+        board->span_count++;
+    }
+    board->height++;
+    board->spans[board->span_count].first_row = board->height;
+    board->spans[board->span_count].first_run = board->run_count;
 }
 
-void draw_board(WINDOW* game_window, GameConfig* game_config) {
-    box(game_window, 0, 0);
+//reads up to max_rows lines of fields (all of them if max_rows is -1), returns how many there were
+int read_run_rows(FILE *file, char buffer[], RunBoard *board, int max_rows){
+    int rows = 0;
+    while((max_rows < 0 || rows < max_rows) && fgets(buffer, MAX_LINE_LENGTH, file)){
+        append_run_row(board, buffer);
+        rows++;
+    }
+    return rows;
+}
 
-    //Colouring grass and road fields on the board with matching color_pairs
-    for (int i = 1; i <= game_config->height; i++) {
-        for (int j = 1; j <= game_config->width; j++) {
-            if (game_config->board[i - 1][j - 1] == 'R') {
-                wattron(game_window, COLOR_PAIR(2));
-                mvwprintw(game_window, i, j, " ");
-                wattroff(game_window, COLOR_PAIR(2));
-            }
-            else if (game_config->board[i - 1][j - 1] == 'G') {
-                wattron(game_window, COLOR_PAIR(1));
-                mvwprintw(game_window, i, j, " ");
-                wattroff(game_window, COLOR_PAIR(1));
-            }
-            else if (game_config->board[i - 1][j - 1] == 'O') {
-                wattron(game_window, COLOR_PAIR(6));
-                mvwprintw(game_window, i, j, "-");
-                wattroff(game_window, COLOR_PAIR(6));
-            }
+//the runs of a row are [*first, *end), found in O(log spans)
+void row_runs(RunBoard *board, int row, int *first, int *end){
+    int low = 0, high = board->span_count - 1;
+    while(low < high){
+        int middle = (low + high + 1) / 2;
+        if(board->spans[middle].first_row <= row){
+            low = middle;
+        }
+        else{
+            high = middle - 1;
         }
     }
+    *first = board->spans[low].first_run;
+    *end = board->spans[low + 1].first_run;
+}
 
-    wrefresh(game_window);
+int run_length(RunBoard *board, int run, int end){
+    int next = run + 1 < end ? board->runs[run + 1].start : board->width;
+    return next - board->runs[run].start;
 }
 
-void draw_frog(WINDOW* game_window, Frog* frog) {
-    wattron(game_window, COLOR_PAIR(3));
-    if (frog->direction == 'U') {
-        mvwprintw(game_window, frog->y, frog->x, "''");
-    }
-    else if (frog->direction == 'D') {
-        mvwprintw(game_window, frog->y, frog->x, "..");
-    }
-    else if (frog->direction == 'R') {
-        mvwprintw(game_window, frog->y, frog->x, " =");
-    }
-    else {
-        mvwprintw(game_window, frog->y, frog->x, "= ");
+//the run a cell belongs to, in O(log spans + log runs of the row)
+int find_run(RunBoard *board, int row, int column){
+    int low, end;
+    row_runs(board, row, &low, &end);
+    int high = end - 1;
+    while(low < high){
+        int middle = (low + high + 1) / 2;
+        if(board->runs[middle].start <= column){
+            low = middle;
+        }
+        else{
+            high = middle - 1;
+        }
     }
-    wattroff(game_window, COLOR_PAIR(3));
+    return low;
 }
 
-            //DRAWING DIFFERENT TYPES OF CARS
-void draw_hostile_car(WINDOW *game_window, Car *car, GameConfig *game_config){
-    wattron(game_window, COLOR_PAIR(5));
-    if(car->direction == 1){
-        mvwprintw(game_window, car->y, car->x, "' '*");
-        mvwprintw(game_window, car->y + 1, car->x, ". .*");
-    }
-    else{
-        mvwprintw(game_window, car->y, car->x, "*' '");
-        mvwprintw(game_window, car->y + 1, car->x, "*. .");
-    }
-    wattroff(game_window, COLOR_PAIR(5));
+char run_field(RunBoard *board, int row, int column){
+    return board->runs[find_run(board, row, column)].field;
 }
-void draw_neutral_car(WINDOW *game_window, Car *car, GameConfig *game_config){
-    wattron(game_window, COLOR_PAIR(7));
-    if(car->direction == 1){
-        mvwprintw(game_window, car->y, car->x, "' '*");
-        mvwprintw(game_window, car->y + 1, car->x, ". .*");
-    }
-    else{
-        mvwprintw(game_window, car->y, car->x, "*' '");
-        mvwprintw(game_window, car->y + 1, car->x, "*. .");
-    }
-    wattroff(game_window, COLOR_PAIR(7));
+
+size_t run_board_bytes(RunBoard *board){
+    return board->span_capacity * sizeof(RowSpan) + board->run_capacity * sizeof(Run);
 }
-void draw_friendly_car(WINDOW *game_window, Car *car, GameConfig *game_config){
-    wattron(game_window, COLOR_PAIR(8));
-    if(car->direction == 1){
-        mvwprintw(game_window, car->y, car->x, "' '*");
-        mvwprintw(game_window, car->y + 1, car->x, ". .*");
-    }
-    else{
-        mvwprintw(game_window, car->y, car->x, "*' '");
-        mvwprintw(game_window, car->y + 1, car->x, "*. .");
-    }
-    wattroff(game_window, COLOR_PAIR(8));
+
+void clear_board_row(BoardPlanes *board, int row){
+    memset(board->road[row], 0, sizeof(board->road[row]));
+    memset(board->grass[row], 0, sizeof(board->grass[row]));
+    memset(board->obstacle[row], 0, sizeof(board->obstacle[row]));
 }
 
-void draw_carrying_car(WINDOW *game_window, Car *car, GameConfig *game_config){
-    wattron(game_window, COLOR_PAIR(3));
-    if(car->direction == 1){
-        mvwprintw(game_window, car->y, car->x, "' '*");
-        mvwprintw(game_window, car->y + 1, car->x, ". .*");
-    }
-    else{
-        mvwprintw(game_window, car->y, car->x, "*' '");
-        mvwprintw(game_window, car->y + 1, car->x, "*. .");
+//a row of a run board goes into a row of the bit planes one run at a time
+void stamp_run_row(GameConfig *game_config, int target, RunBoard *board, int row){
+    clear_board_row(&game_config->board, target);
+    int first, end;
+    row_runs(board, row, &first, &end);
+    for(int i = first; i < end; i++){
+        int length = run_length(board, i, end);
+        if(board->runs[i].field == 'R'){
+            set_bits(game_config->board.road[target], board->runs[i].start, length);
+        }
+        else if(board->runs[i].field == 'G'){
+            set_bits(game_config->board.grass[target], board->runs[i].start, length);
+        }
+        else if(board->runs[i].field == 'O'){
+            set_bits(game_config->board.obstacle[target], board->runs[i].start, length);
+        }
     }
-    wattroff(game_window, COLOR_PAIR(3));
 }
 
-void draw_cars(WINDOW *game_window, Car *cars, GameConfig *game_config){
-    for(int i = 0; i < game_config->car_number; i++){
-        if(cars[i].hidden == true){
+            //CARS OCCUPANCY
+void car_cells(Car *car, bool occupied, GameConfig *game_config){
+    if(car->hidden == true){
+        return;
+    }
+    for(int row = car->y - 1; row < car->y - 1 + CAR_HEIGHT; row++){
+        if(row < 0 || row >= MAX_NUM){
             continue;
         }
-
-        if(cars[i].car_type == 'f' && cars[i].carrying_frog == true){
-            draw_carrying_car(game_window, &cars[i], game_config);
-        }
-        else if(cars[i].car_type == 'h'){
-            draw_hostile_car(game_window, &cars[i], game_config);
+        if(occupied == true){
+            set_bits(game_config->board.cars[row], car->x - 1, CAR_WIDTH);
         }
-        else if(cars[i].car_type == 'n'){
-            draw_neutral_car(game_window, &cars[i], game_config);
-        }
-        else if(cars[i].car_type == 'f'){
-            draw_friendly_car(game_window, &cars[i], game_config);
+        else{
+            clear_bits(game_config->board.cars[row], car->x - 1, CAR_WIDTH);
         }
     }
 }
 
-        //STORK DRAWING SECTION
-void draw_stork(WINDOW *game_window, Stork *stork){
-    if(stork->alive == true){
-        wattron(game_window, COLOR_PAIR(9));
-        mvwprintw(game_window, stork->y, stork->x, "V");
-        mvwprintw(game_window, stork->y - 1, stork->x - 1, "\\ /"); 
-        wattroff(game_window, COLOR_PAIR(9));
+//cars are stamped again from scratch once per frame, so a car that was respawned on top of another one can't leave a hole for longer than that
+void rebuild_cars_plane(GameConfig *game_config, Car *cars){
+    memset(game_config->board.cars, 0, sizeof(game_config->board.cars));
+    for(int i = 0; i < game_config->car_pool.count; i++){
+        car_cells(&cars[i], true, game_config);
     }
 }
 
+//FILE RELATED SECTION:
+        //GETTING PARAMETERS FROM THE CONFIG FILE, PREPARING THE GAME
+//levels are also parsed on the loader thread while curses has the terminal, so errors are kept, not printed
+void config_error(GameConfig *game_config, const char *format, ...){
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(game_config->error, sizeof(game_config->error), format, arguments);
+    va_end(arguments);
+}
 
-// MOVEMENT SECTION OF FROG AND CARS
+FILE* open_config(GameConfig *game_config){
+    FILE *file = fopen(game_config->file_name, "r");
+    if(!file){
+        config_error(game_config, "There is no file with given name.");
+    }
+    return file;
+}
 
-bool is_frog_near(Frog *frog, Car *car){
-    int distance_x;
-    if(car->direction == 1){
-        distance_x = frog->x - (CAR_WIDTH - 2 + car->x);
+bool parse_basic_data(char buffer[], GameConfig *game_config, Frog *frog){
+    int temp;
+    if (sscanf(buffer, "jump_delay=%d", &frog->jump_delay) == 1) {
+        return true;
     }
-    else if(car->direction == -1){
-        distance_x = frog->x - car->x ;
+    if (sscanf(buffer, "jump_buffer=%d", &frog->jump_buffer) == 1) {
+        return true;
     }
-
-    if(distance_x < 0){
-        distance_x *= -1;
+    if (sscanf(buffer, "road_lanes=%d", &game_config->road_lanes) == 1){ 
+        return true;
     }
-
-    int distance_y = frog->y - car->y;
-    if(frog->y < car->y){
-        distance_y--;
+    if (sscanf(buffer, "n_car_chance=%d", &game_config->f_car_chance) == 1){
+        return true;
     }
-
-    if(distance_y < 0){
-        distance_y *= -1;
+    if (sscanf(buffer, "f_car_chance=%d", &game_config->n_car_chance) == 1){
+        return true;
     }
-
-    if(distance_x <= PROXIMITY && distance_y <= PROXIMITY){
+    if (sscanf(buffer, "car_number=%d", &game_config->car_number) == 1){
         return true;
     }
-    else{
-        return false;
+    if (sscanf(buffer, "width=%d", &game_config->width) == 1){ 
+        return true;
+    }
+    if (sscanf(buffer, "height=%d", &game_config->height) == 1){ 
+        return true;
+    }
+    if (sscanf(buffer, "stork_alive=%d", &temp) == 1){ 
+        if(temp == 1){
+            game_config->stork_alive = true;
+        }
+        else{
+            game_config->stork_alive = false;
+        }
+        return true;
+    }
+    if (sscanf(buffer, "stork_count=%d", &game_config->stork_count) == 1){ 
+        return true;
+    }
+    if (sscanf(buffer, "min_car_delay=%d", &game_config->min_car_delay) == 1) {
+        return true;
+    }
+    if (sscanf(buffer, "max_car_delay=%d", &game_config->max_car_delay) == 1) {
+        return true;
+    }
+    if (sscanf(buffer, "endless=%d", &temp) == 1){
+        game_config->endless = temp == 1;
+        return true;
+    }
+    if (sscanf(buffer, "map=%29s", game_config->map_file) == 1){
+        return true;
     }
+
+    //if nothing from above has been found 
+    return false;
 }
 
-bool can_frog_jump(GameConfig *game_config, Frog *frog){
-    if ((clock() - frog->last_jump_time) * 1000 / CLOCKS_PER_SEC >= frog->jump_delay) {      //Checks whether enough time has passed for frog to have another jump
-        return true;                                                                         //If frog is not allowed to jump then terminate the function
+bool parse_seed(FILE *file, char buffer[], GameConfig *game_config){
+    memset(&game_config->board, 0, sizeof(game_config->board));
+    RunBoard seed;
+    init_run_board(&seed, game_config->width);
+    bool is_complete = read_run_rows(file, buffer, &seed, game_config->height) == game_config->height;
+    if (is_complete == false) {
+        config_error(game_config, "Seed is too small, change height and width in the config file.");
     }
     else {
-        return false;
+        for (int i = 0; i < game_config->height; i++) {
+            stamp_run_row(game_config, i, &seed, i);
+        }
     }
+    free_run_board(&seed);
+    return is_complete;
 }
-            //FROGS MOVES UP, DOWN, LEFT, RIGHT
-void frog_move_up(GameConfig* game_config, Frog* frog){
-    if (frog->y > 1) {
-            if(game_config->board[frog->y - 1 - 1][frog->x] != 'O' && game_config->board[frog->y - 1 - 1][frog->x - 1] != 'O'){     //checking if frog doesn't want to jump onto an obstacle
-                frog->y--;
-                frog->moves++;
+
+//the rows of the map= file, every one as wide as the level
+bool load_map(GameConfig *game_config, RunBoard *map){
+    FILE *file = fopen(game_config->map_file, "r");
+    if(!file){
+        config_error(game_config, "There is no map file with given name.");
+        return false;
+    }
+    char buffer[MAX_LINE_LENGTH];
+    init_run_board(map, game_config->width);
+    read_run_rows(file, buffer, map, -1);
+    trim_run_board(map);
+    fclose(file);
+    if(map->height < 2){
+        config_error(game_config, "The map needs at least two rows.");
+        free_run_board(map);
+        return false;
+    }
+    return true;
+}
+
+bool get_data(GameConfig *game_config, Frog *frog, FILE* file){
+    char buffer[MAX_LINE_LENGTH];
+    bool is_seed_found = false;
+
+    while(fgets(buffer, MAX_LINE_LENGTH, file)){
+        if(buffer[0] == '\0' || buffer[0] == '\n'){
+            continue;
+        }
+
+        if (parse_basic_data(buffer, game_config, frog)) continue;
+
+        if (strncmp(buffer, "seed=", 5) == 0) {
+            is_seed_found = true;
+            if (parse_seed(file, buffer, game_config) == false){
+                 return false;
+            }
+        }
+    }
+
+    if (is_seed_found == false) {
+        config_error(game_config, "No seed has been found in the given file.");
+        return false;
+    }
+    return true;
+}
+bool read_config(GameConfig *game_config, Frog *frog){
+    FILE *file = open_config(game_config);
+    if(file == NULL){
+        return false;
+    }
+
+    if(get_data(game_config, frog, file) == false){
+        fclose(file);
+        return false;
+    }
+
+    fclose(file);
+
+    if(game_config->stork_count > MAX_STORKS){
+        config_error(game_config, "There can be at most %d storks.", MAX_STORKS);
+        return false;
+    }
+    if(game_config->stork_count < 0){
+        game_config->stork_count = game_config->stork_alive ? 1 : 0;
+    }
+    return true;
+}
+
+        //LEADERBOARD RELATED FUNCTIONS
+void calculate_score(int time_elapsed, Frog *frog) {
+    int base_score = 1000;            
+    int time_penalty = time_elapsed * 10; 
+    int move_penalty = frog->moves * 5;       
+
+    frog->score = base_score - time_penalty - move_penalty;
+    if (frog->score < 0) frog->score = 0;
+}
+
+void save_score(const char* player_name, int score) {
+    FILE *file = fopen(LEADERBOARD_FILE, "a");
+    if (!file) {
+        std::cerr << "Something's wrong with the leaderboard file.\n";
+        return;
+    }
+    fprintf(file, "%s - %d points.\n", player_name, score);
+    fclose(file);
+}
+
+            //SCORE WRITER - THE LEADERBOARD FILE IS WRITTEN ON ITS OWN THREAD
+void write_scores(ScoreWriter *scores){
+    std::unique_lock<std::mutex> lock(scores->mutex);
+    for(;;){
+        scores->wake.wait(lock, [scores]{
+            return scores->head != scores->tail || scores->running == false;
+        });
+        if(scores->head == scores->tail){
+            return;         //stopped, and everything is written
+        }
+        ScoreEntry entry = scores->queue[scores->head % SCORE_QUEUE_SIZE];
+        scores->head++;
+        scores->busy = true;
+        lock.unlock();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        save_score(entry.name, entry.score);
+        count_score_write(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        lock.lock();
+        scores->busy = false;
+        if(scores->head == scores->tail){
+            scores->idle.notify_all();
+        }
+    }
+}
+
+void start_score_writer(ScoreWriter *scores){
+    scores->head = 0;
+    scores->tail = 0;
+    scores->busy = false;
+    scores->running = true;
+    scores->writer = std::thread(write_scores, scores);
+}
+
+//the scores still waiting are written first
+void stop_score_writer(ScoreWriter *scores){
+    {
+        std::lock_guard<std::mutex> lock(scores->mutex);
+        scores->running = false;
+    }
+    scores->wake.notify_one();
+    scores->writer.join();
+}
+
+//false if the writer is that far behind, then the score is lost
+bool queue_score(ScoreWriter *scores, const char *player_name, int score){
+    {
+        std::lock_guard<std::mutex> lock(scores->mutex);
+        if(scores->tail - scores->head == SCORE_QUEUE_SIZE){
+            return false;
+        }
+        ScoreEntry *entry = &scores->queue[scores->tail % SCORE_QUEUE_SIZE];
+        strncpy(entry->name, player_name, MAX_NUM - 1);
+        entry->name[MAX_NUM - 1] = '\0';
+        entry->score = score;
+        scores->tail++;
+    }
+    scores->wake.notify_one();
+    return true;
+}
+
+//before the leaderboard is read, so it has the last score in it
+void wait_for_scores(ScoreWriter *scores){
+    std::unique_lock<std::mutex> lock(scores->mutex);
+    scores->idle.wait(lock, [scores]{
+        return scores->head == scores->tail && scores->busy == false;
+    });
+}
+
+void print_ranking(int length, int score[], char name[][MAX_NUM], int sorted_indexes[]) {
+    int pos = 6;
+    clear();
+    mvprintw(5, 10, "___=== Game Ranking ===___");
+    for(int i = 0; i < length; i++){
+        mvprintw(pos++, 10, "%d.) %s - %d points.", i + 1, name[sorted_indexes[i]], score[sorted_indexes[i]]);
+    }
+    mvprintw(pos + 2, 10, "Press anything to get back to the main menu.");
+    refresh();
+}
+
+void sort_ranking_data(int length, char name[][MAX_NUM], int score[], int sorted_indexes[]){
+    for(int i = 0; i < length; i++){
+        sorted_indexes[i] = i;
+    }
+
+    for(int i = 0; i < length; i++){
+        for(int j = 1; j < length; j++){
+            if(score[sorted_indexes[j]] > score[sorted_indexes[j - 1]]){
+                int temp = sorted_indexes[j];
+                sorted_indexes[j] = sorted_indexes[j - 1];
+                sorted_indexes[j - 1] = temp;
+            }
+        }
+    }
+}
+
+void show_ranking() {
+    FILE *file = fopen(LEADERBOARD_FILE, "r");
+    if (!file) {
+        std::cerr << "Something's wrong with the leaderboard file.\n";
+        return;
+    }
+
+    char name[MAX_NUM][MAX_NUM]; //creates arrays that are to be sorted based on points
+    int score[MAX_NUM];
+    int length = 0;
+
+    //data from file will be temporarily saved here
+    char temp_name[MAX_NUM];
+    int temp_score;
+    while ((fscanf(file, "%s - %d points.", temp_name, &temp_score) == 2) && length < MAX_NUM) { 
+        strcpy(name[length], temp_name);
+        score[length] = temp_score;
+        length++;
+    }
+
+    int *sorted_indexes = new int[length];
+    sort_ranking_data(length, name, score, sorted_indexes);
+    print_ranking(length, score, name, sorted_indexes);
+    delete[] sorted_indexes;
+   
+    fclose(file);
+}
+
+//the name is typed while the game loop goes on, see step_round_end
+void show_name_prompt(Frog *frog, const char name[]) {
+    mvprintw(3, 3, "Congratulations! You got: %d points.", frog->score);
+    mvprintw(4, 5, "Enter your name: %s", name);
+    clrtoeol();
+    refresh();
+}
+
+//INITIALIZING THE STORKS
+void init_storks(GameConfig *game_config, Stork *storks, Frog *frog){
+    for(int i = 0; i < game_config->stork_count; i++){
+        Stork *stork = &storks[spawn_entity(&game_config->stork_pool)];
+        stork->alive = true;
+        stork->x = game_rand(game_config) % (game_config->width / 2) + 1;
+        stork->y = game_rand(game_config) % (game_config->height / 2) + game_config->height / 2;
+        stork->delay = frog->jump_delay * 2;
+        if(i > 0){
+            stork->delay += game_rand(game_config) % (frog->jump_delay + 1);     //every next stork is a bit slower, so they don't fly as one flock
+        }
+        stork->last_move_time = game_clock();
+        stork->dir_x = 1; 
+        stork->dir_y = 1;
+        stork->prev_x = stork->x;
+        stork->prev_y = stork->y;
+    }
+    game_config->flow.frog_x = -1;
+    game_config->flow.frog_y = -1;
+}
+//dir_x = -1; storks x position is decreasing
+//dir_x = 0; storks x position is not changing
+//dir_x = 1; storks x position is increasing
+//same with dir_y
+
+            //FLOW FIELD - STORKS FLY AROUND OBSTACLES TOWARDS THE FROG
+//cells outside the board have no NAV_STORK bit, only the array bounds are checked here
+bool is_stork_field(GameConfig *game_config, int x, int y){
+    if(x < 0 || x > MAX_NUM + 1 || y < 0 || y > MAX_NUM + 1){
+        return false;
+    }
+    return (game_config->nav[y][x] & NAV_STORK) != 0;
+}
+
+//breadth-first search from both cells of the frog; not incremental, the whole board is searched again
+//whenever the frog gets to another cell, and frames in which it stays where it was reuse the field
+void update_flow_field(GameConfig *game_config, Frog *frog){
+    FlowField *flow = &game_config->flow;
+    if(flow->frog_x == frog->x && flow->frog_y == frog->y){
+        return;
+    }
+    flow->frog_x = frog->x;
+    flow->frog_y = frog->y;
+
+    //only the rows of the board (and the border rows around them) are ever read
+    memset(flow->distance, 0xFF, (game_config->height + 2) * sizeof(flow->distance[0]));
+    int queue[(MAX_NUM + 2) * (MAX_NUM + 2)];
+    int head = 0, tail = 0;
+    for(int x = frog->x; x <= frog->x + 1; x++){
+        if(is_stork_field(game_config, x, frog->y)){
+            flow->distance[frog->y][x] = 0;
+            queue[tail++] = frog->y * (MAX_NUM + 2) + x;
+        }
+    }
+
+    while(head < tail){
+        int y = queue[head] / (MAX_NUM + 2);
+        int x = queue[head] % (MAX_NUM + 2);
+        head++;
+        for(int dy = -1; dy <= 1; dy++){
+            for(int dx = -1; dx <= 1; dx++){
+                if(is_stork_field(game_config, x + dx, y + dy) && flow->distance[y + dy][x + dx] == FLOW_UNREACHABLE){
+                    flow->distance[y + dy][x + dx] = flow->distance[y][x] + 1;
+                    queue[tail++] = (y + dy) * (MAX_NUM + 2) + x + dx;
+                }
+            }
+        }
+    }
+}
+
+void check_whether_in_board(GameConfig *game_config, Stork *stork);
+void set_storks_direction(GameConfig *game_config, Stork *stork, Frog *frog);
+
+void move_stork(GameConfig *game_config, Stork *stork, Frog *frog) {
+    if(stork->alive == true){
+        stork->prev_x = stork->x;
+        stork->prev_y = stork->y;
+        if ((game_clock() - stork->last_move_time) * 1000 / CLOCKS_PER_SEC < stork->delay) {
+            return; 
+        }
+        if(frog->is_carried == false){
+            set_storks_direction(game_config, stork, frog);
+
+            stork->x += stork->dir_x;
+            stork->y += stork->dir_y;
+
+            check_whether_in_board(game_config, stork);
+            stork->last_move_time = game_clock();
+        }
+    }
+}
+
+void move_storks(GameConfig *game_config, Stork *storks, Frog *frog){
+    if(game_config->stork_count > 0 && frog->is_carried == false){
+        update_flow_field(game_config, frog);
+    }
+    for(int i = 0; i < game_config->stork_count; i++){
+        move_stork(game_config, &storks[i], frog);
+    }
+}
+
+            //if the frog can't be reached around the obstacles the stork just flies straight at it
+void set_storks_direction_greedy(Stork *stork, Frog *frog){
+    if (frog->x > stork->x) {
+        stork->dir_x = 1;
+    } else if (frog->x < stork->x) {
+        stork->dir_x = -1;
+    } else {
+        stork->dir_x = 0;
+    }
+
+    if (frog->y > stork->y) {
+        stork->dir_y = 1;
+    } else if (frog->y < stork->y) {
+        stork->dir_y = -1;
+    } else {
+        stork->dir_y = 0;
+    }
+}
+
+//the stork goes to the neighbouring cell which is the closest to the frog
+void set_storks_direction(GameConfig *game_config, Stork *stork, Frog *frog){
+    FlowField *flow = &game_config->flow;
+    int best = FLOW_UNREACHABLE;
+    if(is_stork_field(game_config, stork->x, stork->y)){
+        best = flow->distance[stork->y][stork->x];
+    }
+    stork->dir_x = 0;
+    stork->dir_y = 0;
+
+    for(int dy = -1; dy <= 1; dy++){
+        for(int dx = -1; dx <= 1; dx++){
+            if(is_stork_field(game_config, stork->x + dx, stork->y + dy) && flow->distance[stork->y + dy][stork->x + dx] < best){
+                best = flow->distance[stork->y + dy][stork->x + dx];
+                stork->dir_x = dx;
+                stork->dir_y = dy;
+            }
+        }
+    }
+
+    if(best == FLOW_UNREACHABLE){
+        set_storks_direction_greedy(stork, frog);
+    }
+}
+
+bool swept_boxes_hit(int a_x0, int a_y0, int a_x1, int a_y1, int a_width, int a_height, int b_x0, int b_y0, int b_x1, int b_y1, int b_width, int b_height);
+
+bool check_stork_collision(Frog *frog, Stork *stork) {
+    if(stork->alive == false || frog->is_carried == true){      //a carried frog is off the board, out of the storks reach
+        return false;
+    }
+    //the stork is 1x1, the frog is 2x1; both are swept along their whole move in this frame
+    return swept_boxes_hit(frog->prev_x, frog->prev_y, frog->x, frog->y, 2, 1,
+                           stork->prev_x, stork->prev_y, stork->x, stork->y, 1, 1);
+}
+
+bool check_storks_collision(GameConfig *game_config, Frog *frog, Stork *storks) {
+    for(int i = 0; i < game_config->stork_count; i++){
+        if(check_stork_collision(frog, &storks[i])){
+            return true;
+        }
+    }
+    return false;
+}
+
+void check_whether_in_board(GameConfig *game_config, Stork *stork){
+    if (stork->x <= 1) stork->x = 1;
+    if (stork->x >= game_config->width) stork->x = game_config->width;
+    if (stork->y <= 1) stork->y = 1;
+    if (stork->y >= game_config->height) stork->y = game_config->height;
+}
+
+
+// INITIALIZING THE FROG
+void init_frog(GameConfig* game_config, Frog* frog) {
+    frog->x = game_config->width / 2 + 1;
+    frog->y = game_config->height;
+    frog->direction = 'U';                  // Initial frog's direction (upwards)
+    frog->moves = 0;
+    frog->last_jump_time = game_clock();
+    frog->is_carried = false;
+    frog->is_invincible = false;
+    frog->score = 0;
+    frog->frogs_car = no_handle();
+    frog->prev_x = frog->x;
+    frog->prev_y = frog->y;
+}
+
+// INITIALIZING AND RANDOMIZING CARS
+
+//room in the lane tables; an endless board makes and drops lanes as it scrolls, there's at most one for every two rows
+int lane_capacity(GameConfig *game_config){
+    if(game_config->endless == true){
+        return game_config->height / 2 + 1;
+    }
+    return game_config->road_lanes;
+}
+
+void change_car_position(Car* car, GameConfig* game_config, int roads_pos[], int cars_on_lane[], int* free_lanes, int lane_direction[]) {
+    int lane = -1;
+
+    // Find an empty lane if exists
+    for (int i = 0; i < game_config->road_lanes; i++) {
+        if (cars_on_lane[i] == 0) {
+            lane = i;
+            break;
+        }
+    }
+
+    // If there is none empty lanes pick random one
+    if (lane == -1) {
+        lane = game_rand(game_config) % game_config->road_lanes;
+    } 
+    else if(cars_on_lane[lane] == 0) {
+        (*free_lanes)--; 
+    }
+
+    car->y = roads_pos[lane] + 1;
+    car->direction = lane_direction[lane];
+    cars_on_lane[lane]++;
+    log_event(EVENT_LANE_CHANGE, car->car_type, car->direction == 1 ? 'R' : 'L', car->x, car->y, lane);
+}
+
+void set_cars_type(Car *car, GameConfig *game_config){
+    int temp = ((game_rand(game_config) % 100) * 7937) % 100;
+        if(temp < game_config->f_car_chance){
+            car->car_type = 'f';
+        }
+        else if(temp < (game_config->f_car_chance + game_config->n_car_chance)){
+            car->car_type = 'n';
+        }
+        else{
+            car->car_type = 'h';
+        }
+}
+void init_cars(Car *cars, GameConfig *game_config, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    for(int n = 0; n < game_config->car_number; n++){
+        int i = spawn_entity(&game_config->car_pool);
+        cars[i].x = (game_rand(game_config) % (game_config->width - 2)) + 2;
+        cars[i].delay = (game_rand(game_config) % (game_config->max_car_delay - game_config->min_car_delay)) + game_config->min_car_delay;
+        cars[i].last_move_time = game_clock();
+        cars[i].hidden = false;
+        cars[i].hidden_until = 0;
+        cars[i].until_delay_change = game_clock() + ((game_rand(game_config) % DELAY_CHANGE_T) + DELAY_CHANGE_T) * CLOCKS_PER_SEC / 1000;
+        set_cars_type(&cars[i], game_config);
+        cars[i].carrying_frog = false;
+
+        change_car_position(&cars[i], game_config, roads_pos, cars_on_lane, free_lanes, lane_directions);
+        cars[i].prev_x = cars[i].x;
+        cars[i].prev_y = cars[i].y;
+    }
+}
+
+//INITIALIZING THE GAME
+
+//foreground and background of every colour pair, shared by curses and the ANSI output
+const short color_pairs[COLOR_PAIRS_USED][2] = {
+    {-1, -1},                       //terminal default
+    {23, 23},                       //colour for grass
+    {8, 8},                         //colour for roads
+    {COLOR_YELLOW, 10},             //the frog
+    {COLOR_WHITE, COLOR_BLACK},     //status bar
+    {COLOR_YELLOW, 12},             //colour for hostile cars 
+    {10, 21},                       //obstacles
+    {COLOR_BLACK, 14},              //neutral cars
+    {COLOR_YELLOW, 11},             //friendly cars
+    {COLOR_BLACK, COLOR_WHITE},     //stork
+};
+
+//config files of the levels in the menu
+const char *level_files[LEVEL_COUNT] = {"config_easy.txt", "config_medium.txt", "config_difficult.txt"};
+
+bool start_game() {
+    initscr();             
+    cbreak();              
+    noecho();               
+    keypad(stdscr, TRUE);   
+    curs_set(0);            
+    nodelay(stdscr, TRUE);
+    srand(time(NULL));
+
+    start_color();
+    for(int i = 1; i < COLOR_PAIRS_USED; i++){
+        init_pair(i, color_pairs[i][0], color_pairs[i][1]);
+    }
+
+    return true;
+}
+
+// DRAWING SECTION - STATUS, BOARD, FROG, CARS, STORK
+
+            //SPRITE ATLAS - EVERY PICTURE IN THE GAME, READY TO BE COPIED TO THE SCREEN
+//a sprite row is a run of cells with the colour already in them, so it's drawn with one waddchnstr instead of printf
+typedef struct {
+    int dx;                 //where the row starts, relative to the entity's x
+    int length;
+    chtype cells[SPRITE_MAX_WIDTH];
+} SpriteRow;
+
+typedef struct {
+    int dy;                 //row of the first line, relative to the entity's y
+    int height;
+    SpriteRow rows[SPRITE_MAX_HEIGHT];
+} Sprite;
+
+constexpr chtype glyph(char character, int pair){
+    return (chtype)(unsigned char)character | COLOR_PAIR(pair);
+}
+
+#define CAR_SPRITES(pair) \
+    {0, 2, {{0, 4, {glyph('\'', pair), glyph(' ', pair), glyph('\'', pair), glyph('*', pair)}}, \
+            {0, 4, {glyph('.', pair), glyph(' ', pair), glyph('.', pair), glyph('*', pair)}}}}, \
+    {0, 2, {{0, 4, {glyph('*', pair), glyph('\'', pair), glyph(' ', pair), glyph('\'', pair)}}, \
+            {0, 4, {glyph('*', pair), glyph('.', pair), glyph(' ', pair), glyph('.', pair)}}}}
+
+constexpr Sprite sprites[SPRITE_COUNT] = {
+    {0, 1, {{0, 2, {glyph('\'', 3), glyph('\'', 3)}}}},             //frog going up
+    {0, 1, {{0, 2, {glyph('.', 3), glyph('.', 3)}}}},               //down
+    {0, 1, {{0, 2, {glyph(' ', 3), glyph('=', 3)}}}},               //right
+    {0, 1, {{0, 2, {glyph('=', 3), glyph(' ', 3)}}}},               //left
+    CAR_SPRITES(5),                                                 //hostile cars going right and left
+    CAR_SPRITES(7),                                                 //neutral cars
+    CAR_SPRITES(8),                                                 //friendly cars
+    CAR_SPRITES(3),                                                 //a friendly car with the frog inside
+    {-1, 2, {{-1, 3, {glyph('\\', 9), glyph(' ', 9), glyph('/', 9)}},  //stork
+             {0, 1, {glyph('V', 9)}}}},
+    {0, 1, {{0, 1, {glyph(' ', 2)}}}},                              //road
+    {0, 1, {{0, 1, {glyph(' ', 1)}}}},                              //grass
+    {0, 1, {{0, 1, {glyph('-', 6)}}}},                              //obstacle
+};
+
+int frog_sprite(Frog *frog){
+    switch(frog->direction){
+        case 'U': return SPRITE_FROG;
+        case 'D': return SPRITE_FROG + 1;
+        case 'R': return SPRITE_FROG + 2;
+    }
+    return SPRITE_FROG + 3;
+}
+
+int car_sprite(Car *car){
+    int sprite;
+    if(car->car_type == 'f' && car->carrying_frog == true){
+        sprite = SPRITE_CARRYING_CAR;
+    }
+    else if(car->car_type == 'n'){
+        sprite = SPRITE_NEUTRAL_CAR;
+    }
+    else if(car->car_type == 'f'){
+        sprite = SPRITE_FRIENDLY_CAR;
+    }
+    else{
+        sprite = SPRITE_HOSTILE_CAR;
+    }
+    if(car->direction != 1){
+        sprite++;
+    }
+    return sprite;
+}
+
+//one row of the board as cells, so the whole row is drawn at once
+chtype field_cell(char field){
+    if(field == 'R'){
+        return sprites[SPRITE_ROAD].rows[0].cells[0];
+    }
+    else if(field == 'G'){
+        return sprites[SPRITE_GRASS].rows[0].cells[0];
+    }
+    else if(field == 'O'){
+        return sprites[SPRITE_OBSTACLE].rows[0].cells[0];
+    }
+    return glyph(' ', 0);
+}
+
+void board_row(BoardPlanes *board, int width, int row, chtype line[]){
+    for(int j = 0; j < width; j++){
+        line[j] = field_cell(plane_field(board, row, j));
+    }
+}
+
+void blit_sprite(WINDOW *game_window, int sprite, int y, int x){
+    const Sprite *picture = &sprites[sprite];
+    for(int r = 0; r < picture->height; r++){
+        const SpriteRow *row = &picture->rows[r];
+        mvwaddchnstr(game_window, y + picture->dy + r, x + row->dx, row->cells, row->length);
+    }
+}
+
+void draw_status(GameConfig* game_config, Frog* frog, int time_elapsed, int distance, bool paused) {
+    attron(COLOR_PAIR(4));
+    if(game_config->endless == true){
+        mvprintw(game_config->height + 2, 0, "Jakub Sledzik | ID: 203221 | Ruchy: %d | Czas: %ds | Dystans: %d", frog->moves, time_elapsed, distance);
+    }
+    else{
+        mvprintw(game_config->height + 2, 0, "Jakub Sledzik | ID: 203221 | Ruchy: %d | Czas: %ds", frog->moves, time_elapsed);
+    }
+    if(paused == true){
+        printw(" | PAUZA (p - dalej, q - koniec)");
+    }
+    clrtoeol();
+    attroff(COLOR_PAIR(4));
+}
+
+void draw_board(WINDOW* game_window, GameConfig* game_config, BoardPlanes *board) {
+    box(game_window, 0, 0);
+
+    //Colouring grass and road fields on the board with matching color_pairs
+    chtype line[MAX_NUM];
+    for (int i = 1; i <= game_config->height; i++) {
+        board_row(board, game_config->width, i - 1, line);
+        mvwaddchnstr(game_window, i, 1, line, game_config->width);
+    }
+}
+
+void draw_frog(WINDOW* game_window, Frog* frog) {
+    blit_sprite(game_window, frog_sprite(frog), frog->y, frog->x);
+}
+
+void draw_cars(WINDOW *game_window, Car *cars, int car_count, GameConfig *game_config){
+    for(int i = 0; i < car_count; i++){
+        blit_sprite(game_window, car_sprite(&cars[i]), cars[i].y, cars[i].x);
+    }
+}
+
+        //STORK DRAWING SECTION
+void draw_stork(WINDOW *game_window, Stork *stork){
+    if(stork->alive == true){
+        blit_sprite(game_window, SPRITE_STORK, stork->y, stork->x);
+    }
+}
+
+void draw_storks(WINDOW *game_window, Stork *storks, int stork_count){
+    for(int i = 0; i < stork_count; i++){
+        draw_stork(game_window, &storks[i]);
+    }
+}
+
+            //ANSI OUTPUT - FRAME DIFFS INSTEAD OF CURSES
+size_t ansi_screen_bytes(GameConfig *game_config){
+    size_t cells = (game_config->height + 4) * (MAX_LINE_LENGTH);
+    return 2 * arena_aligned(cells * sizeof(Cell)) + arena_aligned(cells * ANSI_CELL_BYTES);
+}
+
+void init_ansi_screen(AnsiScreen *screen, GameConfig *game_config, Arena *arena){
+    screen->rows = game_config->height + 4;         //the board with its frame and the two status lines
+    screen->columns = MAX_LINE_LENGTH;
+    int cells = screen->rows * screen->columns;
+    screen->front = (Cell*)arena_alloc(arena, cells * sizeof(Cell));
+    screen->back = (Cell*)arena_alloc(arena, cells * sizeof(Cell));
+    screen->out = (char*)arena_alloc(arena, cells * ANSI_CELL_BYTES);
+    for(int i = 0; i < cells; i++){
+        screen->front[i].character = 0;             //nothing matches it, so the first frame is sent whole
+        screen->front[i].pair = 0;
+    }
+    screen->frames = 0;
+    screen->bytes = 0;
+    screen->last_bytes = 0;
+}
+
+void cells_print(AnsiScreen *screen, int y, int x, const char *text, int pair){
+    if(y < 0 || y >= screen->rows){
+        return;
+    }
+    for(; *text != '\0' && x < screen->columns; text++, x++){
+        if(x >= 0){
+            screen->back[y * screen->columns + x].character = *text;
+            screen->back[y * screen->columns + x].pair = pair;
+        }
+    }
+}
+
+void cells_put(AnsiScreen *screen, int y, int x, const chtype cells[], int length){
+    if(y < 0 || y >= screen->rows){
+        return;
+    }
+    for(int i = 0; i < length; i++, x++){
+        if(x >= 0 && x < screen->columns){
+            screen->back[y * screen->columns + x].character = cells[i] & A_CHARTEXT;
+            screen->back[y * screen->columns + x].pair = PAIR_NUMBER(cells[i]);
+        }
+    }
+}
+
+void cells_blit_sprite(AnsiScreen *screen, int sprite, int y, int x){
+    const Sprite *picture = &sprites[sprite];
+    for(int r = 0; r < picture->height; r++){
+        const SpriteRow *row = &picture->rows[r];
+        cells_put(screen, y + picture->dy + r, x + row->dx, row->cells, row->length);
+    }
+}
+
+void cells_clear(AnsiScreen *screen){
+    for(int i = 0; i < screen->rows * screen->columns; i++){
+        screen->back[i].character = ' ';
+        screen->back[i].pair = 0;
+    }
+}
+
+int ansi_color_code(char *out, int pair){
+    if(pair == 0){
+        return sprintf(out, "\x1b[0m");
+    }
+    return sprintf(out, "\x1b[38;5;%d;48;5;%dm", color_pairs[pair][0], color_pairs[pair][1]);
+}
+
+bool same_cell(Cell a, Cell b){
+    return a.character == b.character && a.pair == b.pair;
+}
+
+//sends the cells that differ from what the terminal shows, the colour is only changed when it's different from the previous cell
+//and short gaps of unchanged cells are written over instead of moving the cursor
+void ansi_flush(AnsiScreen *screen){
+    char *out = screen->out;
+    int length = 0;
+    int cursor_y = -1, cursor_x = -1;
+    int pair = -1;
+
+    for(int y = 0; y < screen->rows; y++){
+        for(int x = 0; x < screen->columns; x++){
+            Cell cell = screen->back[y * screen->columns + x];
+            if(same_cell(cell, screen->front[y * screen->columns + x])){
+                continue;
+            }
+
+            if(cursor_y != y || cursor_x != x){
+                bool rewrite = (cursor_y == y && x > cursor_x && x - cursor_x <= 3);
+                for(int gap = cursor_x; rewrite && gap < x; gap++){
+                    rewrite = screen->back[y * screen->columns + gap].pair == pair;
+                }
+                if(rewrite){
+                    for(int gap = cursor_x; gap < x; gap++){
+                        out[length++] = screen->back[y * screen->columns + gap].character;
+                    }
+                }
+                else if(cursor_y == y && x > cursor_x){
+                    length += sprintf(out + length, "\x1b[%dC", x - cursor_x);
+                }
+                else{
+                    length += sprintf(out + length, "\x1b[%d;%dH", y + 1, x + 1);
+                }
+            }
+            if(cell.pair != pair){
+                length += ansi_color_code(out + length, cell.pair);
+                pair = cell.pair;
+            }
+            out[length++] = cell.character;
+            cursor_y = y;
+            cursor_x = x + 1;
+            screen->front[y * screen->columns + x] = cell;
+        }
+    }
+    if(pair > 0){
+        length += ansi_color_code(out + length, 0);
+    }
+
+    for(int written = 0; written < length; ){
+        int count = write(1, out + written, length - written);
+        if(count <= 0){
+            break;
+        }
+        written += count;
+    }
+    screen->frames++;
+    screen->bytes += length;
+    screen->last_bytes = length;
+}
+
+//the second status line, what the frame watchdog has done so far
+void watchdog_status(char status[], size_t size, FrameWatchdog *watchdog){
+    snprintf(status, size, "Budzet klatki: %ld ms | Pominiete: symulacja %lld, rysowanie %lld, spoznione %lld",
+             (long)(watchdog->budget * 1000 / CLOCKS_PER_SEC), watchdog->skipped[SKIP_SIMULATION].load(),
+             watchdog->skipped[SKIP_DECIMATED].load(), watchdog->skipped[SKIP_LATE].load());
+}
+
+//the same picture draw_snapshot makes with curses
+void draw_snapshot_ansi(Renderer *renderer, Snapshot *snapshot){
+    AnsiScreen *screen = &renderer->ansi;
+    GameConfig *game_config = renderer->game_config;
+    cells_clear(screen);
+
+    for(int x = 1; x <= game_config->width; x++){
+        cells_print(screen, 0, x, "-", 0);
+        cells_print(screen, game_config->height + 1, x, "-", 0);
+    }
+    for(int y = 0; y <= game_config->height + 1; y++){
+        const char *side = (y == 0 || y == game_config->height + 1) ? "+" : "|";
+        cells_print(screen, y, 0, side, 0);
+        cells_print(screen, y, game_config->width + 1, side, 0);
+    }
+    chtype line[MAX_NUM];
+    for (int i = 1; i <= game_config->height; i++) {
+        board_row(snapshot->board, game_config->width, i - 1, line);
+        cells_put(screen, i, 1, line, game_config->width);
+    }
+
+    Frog *frog = &snapshot->frog;
+    if(frog->is_carried == false){
+        cells_blit_sprite(screen, frog_sprite(frog), frog->y, frog->x);
+    }
+    for(int i = 0; i < snapshot->car_count; i++){
+        cells_blit_sprite(screen, car_sprite(&snapshot->cars[i]), snapshot->cars[i].y, snapshot->cars[i].x);
+    }
+    for(int i = 0; i < snapshot->stork_count; i++){
+        cells_blit_sprite(screen, SPRITE_STORK, snapshot->storks[i].y, snapshot->storks[i].x);
+    }
+
+    char status[MAX_LINE_LENGTH];
+    long long average = screen->frames > 0 ? screen->bytes / screen->frames : 0;
+    int length = snprintf(status, sizeof(status), "Jakub Sledzik | ID: 203221 | Ruchy: %d | Czas: %ds | ", frog->moves, snapshot->time_elapsed);
+    if(game_config->endless == true){
+        length += snprintf(status + length, sizeof(status) - length, "Dystans: %d | ", snapshot->distance);
+    }
+    length += snprintf(status + length, sizeof(status) - length, "Bajty/klatka: %d (srednio %lld)", screen->last_bytes, average);
+    if(snapshot->paused == true){
+        snprintf(status + length, sizeof(status) - length, " | PAUZA (p - dalej, q - koniec)");
+    }
+    cells_print(screen, game_config->height + 2, 0, status, 4);
+    watchdog_status(status, sizeof(status), &renderer->watchdog);
+    cells_print(screen, game_config->height + 3, 0, status, 4);
+
+    ansi_flush(screen);
+}
+
+            //SPECTATORS - FRAMES FOR OTHER PROCESSES THROUGH SHARED MEMORY
+//the segment this process created; it's unlinked however the process ends (return from main, exit or a signal)
+char spectator_segment[256] = "";
+struct sigaction previous_handlers[NSIG];
+
+void unlink_spectator_segment(){
+    if(spectator_segment[0] != '\0'){
+        shm_unlink(spectator_segment);
+        spectator_segment[0] = '\0';
+    }
+}
+
+//the handler that was there before (curses restores the terminal in its own) still runs afterwards
+void unlink_spectator_on_signal(int signal_number){
+    unlink_spectator_segment();
+    if(previous_handlers[signal_number].sa_handler != SIG_DFL && previous_handlers[signal_number].sa_handler != SIG_IGN){
+        previous_handlers[signal_number].sa_handler(signal_number);
+    }
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+void guard_spectator_segment(const char *name){
+    static bool guarded = false;
+    strncpy(spectator_segment, name, sizeof(spectator_segment) - 1);
+    if(guarded == true){
+        return;
+    }
+    guarded = true;
+    atexit(unlink_spectator_segment);
+    const int signals[4] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = unlink_spectator_on_signal;
+    sigemptyset(&action.sa_mask);
+    for(int i = 0; i < 4; i++){
+        sigaction(signals[i], &action, &previous_handlers[signals[i]]);
+    }
+}
+
+//created by the game, name is a POSIX shared memory name like /frogger
+//a segment left by a process that was killed outright is removed first, so every broadcast starts with a fresh one
+SpectatorRing *open_spectator_ring(const char *name){
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0){
+        return NULL;
+    }
+    guard_spectator_segment(name);
+    if(ftruncate(fd, sizeof(SpectatorRing)) < 0){
+        close(fd);
+        return NULL;
+    }
+    void *memory = mmap(NULL, sizeof(SpectatorRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED){
+        return NULL;
+    }
+    SpectatorRing *ring = (SpectatorRing*)memory;
+    ring->board_sequence.store(0);
+    ring->level = 0;
+    ring->width = 0;
+    ring->height = 0;
+    ring->newest.store(-1);
+    for(int i = 0; i < SPECTATOR_SLOTS; i++){
+        ring->slots[i].sequence.store(0);
+    }
+    ring->open.store(true);
+    ring->magic = SPECTATOR_MAGIC;
+    return ring;
+}
+
+void close_spectator_ring(SpectatorRing *ring, const char *name){
+    ring->open.store(false, std::memory_order_release);
+    munmap(ring, sizeof(SpectatorRing));
+    shm_unlink(name);
+    spectator_segment[0] = '\0';
+}
+
+//at the start of every round, and every time an endless board scrolls
+void publish_board(SpectatorRing *ring, BoardPlanes *board, int width, int height){
+    unsigned int sequence = ring->board_sequence.load(std::memory_order_relaxed);
+    ring->board_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ring->level++;
+    ring->width = width;
+    ring->height = height;
+    for(int i = 0; i < height; i++){
+        for(int j = 0; j < width; j++){
+            ring->board[i * width + j] = plane_field(board, i, j);
+        }
+    }
+    ring->board_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+int snapshot_entities(Snapshot *snapshot, NetEntity entities[]){
+    int count = 0;
+    if(snapshot->frog.is_carried == false){
+        entities[count].x = snapshot->frog.x;
+        entities[count].y = snapshot->frog.y;
+        entities[count].sprite = frog_sprite(&snapshot->frog);
+        count++;
+    }
+    for(int i = 0; i < snapshot->car_count && count < SPECTATOR_ENTITIES; i++){
+        entities[count].x = snapshot->cars[i].x;
+        entities[count].y = snapshot->cars[i].y;
+        entities[count].sprite = car_sprite(&snapshot->cars[i]);
+        count++;
+    }
+    for(int i = 0; i < snapshot->stork_count && count < SPECTATOR_ENTITIES; i++){
+        if(snapshot->storks[i].alive == true){
+            entities[count].x = snapshot->storks[i].x;
+            entities[count].y = snapshot->storks[i].y;
+            entities[count].sprite = SPRITE_STORK;
+            count++;
+        }
+    }
+    return count;
+}
+
+//a seqlock per slot: the sequence is odd while the slot is written, so a viewer can tell it read a torn frame
+SpectatorSlot *begin_spectator_frame(SpectatorRing *ring){
+    int frame = ring->newest.load(std::memory_order_relaxed) + 1;
+    SpectatorSlot *slot = &ring->slots[frame % SPECTATOR_SLOTS];
+    unsigned int sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->level = ring->level;
+    return slot;
+}
+
+void end_spectator_frame(SpectatorRing *ring, SpectatorSlot *slot){
+    slot->sequence.store(slot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    ring->newest.store(ring->newest.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void publish_spectator_frame(SpectatorRing *ring, Snapshot *snapshot){
+    SpectatorSlot *slot = begin_spectator_frame(ring);
+    slot->moves = snapshot->frog.moves;
+    slot->time_elapsed = snapshot->time_elapsed;
+    slot->count = snapshot_entities(snapshot, slot->entities);
+    end_spectator_frame(ring, slot);
+}
+
+            //FRAME WATCHDOG - THE SIMULATION KEEPS ITS RATE, THE DRAWING GIVES WAY
+void init_watchdog(FrameWatchdog *watchdog, int budget){
+    watchdog->budget = (clock_t)budget * CLOCKS_PER_SEC / 1000;
+    watchdog->simulation_cost.store(0);
+    watchdog->render_cost = 0;
+    watchdog->render_every.store(1);
+    watchdog->countdown = 0;
+    watchdog->unpublished = 0;
+    for(int i = 0; i < SKIP_REASONS; i++){
+        watchdog->skipped[i].store(0);
+    }
+}
+
+clock_t average_cost(clock_t average, clock_t cost){
+    return average + (cost - average) / FRAME_COST_AVERAGE;
+}
+
+//called by the simulation after every frame; false if the frame shouldn't even be handed to the renderer
+bool simulation_fits(FrameWatchdog *watchdog, clock_t cost){
+    clock_t average = average_cost(watchdog->simulation_cost.load(std::memory_order_relaxed), cost);
+    watchdog->simulation_cost.store(average, std::memory_order_relaxed);
+    if(average >= watchdog->budget && ++watchdog->unpublished < MAX_RENDER_EVERY){
+        watchdog->skipped[SKIP_SIMULATION].fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    watchdog->unpublished = 0;
+    return true;
+}
+
+//called by the renderer for every snapshot it takes
+bool should_draw(FrameWatchdog *watchdog){
+    if(--watchdog->countdown > 0){
+        watchdog->skipped[SKIP_DECIMATED].fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    watchdog->countdown = watchdog->render_every.load(std::memory_order_relaxed);
+    return true;
+}
+
+//a drawn frame costs render_cost, spread over render_every frames of the simulation;
+//the drawing is halved when that doesn't fit and doubled again once it fits with a quarter of the budget to spare
+void record_render_cost(FrameWatchdog *watchdog, clock_t cost){
+    watchdog->render_cost = average_cost(watchdog->render_cost, cost);
+    clock_t simulation = watchdog->simulation_cost.load(std::memory_order_relaxed);
+    int every = watchdog->render_every.load(std::memory_order_relaxed);
+    if(every < MAX_RENDER_EVERY && simulation + watchdog->render_cost / every > watchdog->budget){
+        every *= 2;
+    }
+    else if(every > 1 && simulation + watchdog->render_cost / (every / 2) <= watchdog->budget * 3 / 4){
+        every /= 2;
+    }
+    watchdog->render_every.store(every, std::memory_order_relaxed);
+}
+
+void init_renderer(Renderer *renderer, WINDOW *game_window, GameConfig *game_config, Arena *arena){
+    if(game_config->output == OUTPUT_ANSI){
+        init_ansi_screen(&renderer->ansi, game_config, arena);
+    }
+    for(int i = 0; i < 3; i++){
+        renderer->buffers[i].cars = (Car*)arena_alloc(arena, game_config->car_number * sizeof(Car));
+        renderer->buffers[i].storks = (Stork*)arena_alloc(arena, game_config->stork_count * sizeof(Stork));
+        renderer->buffers[i].car_count = 0;
+        renderer->buffers[i].stork_count = 0;
+        renderer->buffers[i].distance = 0;
+        renderer->buffers[i].paused = false;
+        //a board that scrolls is changed by the simulation, so every snapshot needs its own copy
+        if(game_config->endless == true){
+            renderer->buffers[i].board = (BoardPlanes*)arena_alloc(arena, sizeof(BoardPlanes));
+            memcpy(renderer->buffers[i].board, &game_config->board, sizeof(BoardPlanes));
+        }
+        else{
+            renderer->buffers[i].board = &game_config->board;
+        }
+    }
+    renderer->back = 0;
+    renderer->middle.store(1);
+    renderer->front = 2;
+    renderer->game_window = game_window;
+    renderer->game_config = game_config;
+    renderer->board_distance = 0;
+    init_watchdog(&renderer->watchdog, game_config->frame_budget);
+    if(game_config->spectators != NULL){
+        publish_board(game_config->spectators, &game_config->board, game_config->width, game_config->height);
+    }
+}
+
+//copies the state of the game into the back buffer and swaps it with the middle one
+void publish_snapshot(Renderer *renderer, GameConfig *game_config, Frog *frog, Car *cars, Stork *storks, int time_elapsed, bool paused){
+    Snapshot *snapshot = &renderer->buffers[renderer->back];
+    snapshot->frog = *frog;
+    snapshot->car_count = game_config->car_pool.count;     //only the live cars, the hidden ones are parked after them
+    memcpy(snapshot->cars, cars, snapshot->car_count * sizeof(Car));
+    snapshot->stork_count = game_config->stork_count;
+    memcpy(snapshot->storks, storks, snapshot->stork_count * sizeof(Stork));
+    snapshot->time_elapsed = time_elapsed;
+    if(game_config->endless == true){
+        memcpy(snapshot->board, &game_config->board, sizeof(BoardPlanes));
+    }
+    snapshot->distance = game_config->distance;
+    snapshot->paused = paused;
+
+    int previous = renderer->middle.exchange(renderer->back | SNAPSHOT_FRESH);
+    if(previous & SNAPSHOT_FRESH){
+        renderer->watchdog.skipped[SKIP_LATE].fetch_add(1, std::memory_order_relaxed);
+    }
+    renderer->back = previous & ~SNAPSHOT_FRESH;
+
+    std::lock_guard<std::mutex> lock(renderer->wake_mutex);
+    renderer->wake.notify_one();
+}
+
+//takes the newest snapshot if there is one the renderer hasn't drawn yet
+bool take_snapshot(Renderer *renderer){
+    if((renderer->middle.load() & SNAPSHOT_FRESH) == 0){
+        return false;
+    }
+    renderer->front = renderer->middle.exchange(renderer->front) & ~SNAPSHOT_FRESH;
+    return true;
+}
+
+void draw_snapshot(Renderer *renderer){
+    Snapshot *snapshot = &renderer->buffers[renderer->front];
+    WINDOW *game_window = renderer->game_window;
+    if(renderer->game_config->output == OUTPUT_ANSI && renderer->running.load() == true){
+        draw_snapshot_ansi(renderer, snapshot);
+        return;
+    }
+
+    draw_board(game_window, renderer->game_config, snapshot->board);
+    if(snapshot->frog.is_carried == false){
+        draw_frog(game_window, &snapshot->frog);
+    }
+    draw_cars(game_window, snapshot->cars, snapshot->car_count, renderer->game_config);
+    draw_status(renderer->game_config, &snapshot->frog, snapshot->time_elapsed, snapshot->distance, snapshot->paused);
+    draw_storks(game_window, snapshot->storks, snapshot->stork_count);
+    char status[MAX_LINE_LENGTH];
+    watchdog_status(status, sizeof(status), &renderer->watchdog);
+    attron(COLOR_PAIR(4));
+    mvprintw(renderer->game_config->height + 3, 0, "%s", status);
+    attroff(COLOR_PAIR(4));
+
+    wnoutrefresh(stdscr);       //the status bar
+    wnoutrefresh(game_window);
+    doupdate();
+}
+
+void render_frames(Renderer *renderer){
+    while(renderer->running.load()){
+        {
+            std::unique_lock<std::mutex> lock(renderer->wake_mutex);
+            renderer->wake.wait_for(lock, std::chrono::milliseconds(FRAME_TIME), [renderer]{
+                return (renderer->middle.load() & SNAPSHOT_FRESH) != 0 || renderer->running.load() == false;
+            });
+        }
+        if(take_snapshot(renderer)){
+            Snapshot *snapshot = &renderer->buffers[renderer->front];
+            if(snapshot->paused == true || should_draw(&renderer->watchdog)){       //the paused frame stays on the screen, it can't be skipped
+                clock_t start = game_clock();
+                draw_snapshot(renderer);
+                record_render_cost(&renderer->watchdog, game_clock() - start);
+            }
+            SpectatorRing *spectators = renderer->game_config->spectators;
+            if(spectators != NULL){
+                if(snapshot->distance != renderer->board_distance){
+                    publish_board(spectators, snapshot->board, renderer->game_config->width, renderer->game_config->height);
+                    renderer->board_distance = snapshot->distance;
+                }
+                publish_spectator_frame(spectators, snapshot);
+            }
+        }
+    }
+}
+
+void start_renderer(Renderer *renderer){
+    renderer->running.store(true);
+    renderer->drawer = std::thread(render_frames, renderer);
+}
+
+//after this only the calling thread uses curses; the newest frame is drawn so the end of the round is on the screen
+//it's drawn even if the render thread already took it, the watchdog may have skipped it there
+void stop_renderer(Renderer *renderer){
+    if(renderer->drawer.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(renderer->wake_mutex);
+            renderer->running.store(false);
+        }
+        renderer->wake.notify_one();
+        renderer->drawer.join();
+        take_snapshot(renderer);
+        //curses doesn't know what the ANSI output has put on the screen, so the last frame is drawn by curses from scratch
+        if(renderer->game_config->output == OUTPUT_ANSI){
+            clearok(curscr, TRUE);
+        }
+        draw_snapshot(renderer);
+    }
+}
+
+
+// MOVEMENT SECTION OF FROG AND CARS
+
+bool is_frog_near(Frog *frog, Car *car){
+    int distance_x;
+    if(car->direction == 1){
+        distance_x = frog->x - (CAR_WIDTH - 2 + car->x);
+    }
+    else if(car->direction == -1){
+        distance_x = frog->x - car->x ;
+    }
+
+    if(distance_x < 0){
+        distance_x *= -1;
+    }
+
+    int distance_y = frog->y - car->y;
+    if(frog->y < car->y){
+        distance_y--;
+    }
+
+    if(distance_y < 0){
+        distance_y *= -1;
+    }
+
+    if(distance_x <= PROXIMITY && distance_y <= PROXIMITY){
+        return true;
+    }
+    else{
+        return false;
+    }
+}
+
+//is_frog_near for every frog of a crowd at once, the box of cells it accepts is looked up in the frogs plane
+bool is_crowd_frog_near(GameConfig *game_config, Car *car){
+    int front = car->direction == 1 ? car->x + CAR_WIDTH - 2 : car->x;
+    for(int y = car->y - PROXIMITY + 1; y <= car->y + PROXIMITY; y++){
+        if(y >= 1 && y <= MAX_NUM && any_bits(game_config->board.frogs[y - 1], front - PROXIMITY - 1, 2 * PROXIMITY + 1)){
+            return true;
+        }
+    }
+    return false;
+}
+
+template<int MODE>
+bool is_any_frog_near(GameConfig *game_config, Frog *frog, Car *car){
+    if(MODE & MODE_CROWD){
+        return is_crowd_frog_near(game_config, car);
+    }
+    return is_frog_near(frog, car);
+}
+
+clock_t frogs_next_jump(Frog *frog){
+    return frog->last_jump_time + frog->jump_delay * CLOCKS_PER_SEC / 1000;
+}
+
+bool can_frog_jump(GameConfig *game_config, Frog *frog, clock_t time){
+    if (time >= frogs_next_jump(frog)) {      //Checks whether enough time has passed for frog to have another jump
+        return true;                                                                         //If frog is not allowed to jump then terminate the function
+    }
+    else {
+        return false;
+    }
+}
+            //NAVIGATION TABLE - WHERE THE FROG LANDS AFTER A JUMP FROM EVERY CELL
+int nav_up(GameConfig* game_config, int x, int y){
+    if (y > 1) {
+            if(is_obstacle(game_config, y - 1, x, 2) == false){     //checking if frog doesn't want to jump onto an obstacle
+                return NAV_FULL;
+            }
+        }
+        return NAV_BLOCKED;
+}
+
+int nav_down(GameConfig* game_config, int x, int y){
+    if (y < game_config->height) {
+            if(is_obstacle(game_config, y + 1, x, 2) == false){      //checking if frog doesnt want to jump onto an obstacle
+                return NAV_FULL;
+            }
+        }
+        return NAV_BLOCKED;
+}
+
+int nav_right(GameConfig *game_config, int x, int y){
+    if (x < game_config->width - 2) {
+            if(is_obstacle(game_config, y, x + 2, 2) == false){         //checking if frog doesnt want to jump onto an obstacle
+                return NAV_FULL;
+            } 
+            else if(is_obstacle(game_config, y, x + 2, 1) == false){                           //if obstacle is half a normal movement in x-axis away then take a smaller jump
+                return NAV_HALF;
+            }
+        }
+        else if(x < game_config->width - 1){                                                  //if game border is half a normal movement in x-axis away then do a smaller jump
+            if(is_obstacle(game_config, y, x + 2, 1) == false){
+                return NAV_HALF;
+            }
+        }
+        return NAV_BLOCKED;
+}
+
+int nav_left(GameConfig* game_config, int x, int y){
+    if (x > 2) {
+            if(is_obstacle(game_config, y, x - 2, 2) == false){         //checking if frog doesnt want to jump onto an obstacle
+                return NAV_FULL;
+            } 
+            else if(is_obstacle(game_config, y, x - 1, 1) == false){                            //if obstacle is half a normal movement in x-axis away then take a smaller jump
+                return NAV_HALF;
+            }
+        }
+        else if(x > 1){                                                                        //if game border is half a normal movement in x-axis away then do a smaller jump
+            if(is_obstacle(game_config, y, x - 1, 1) == false){
+                return NAV_HALF;
+            }
+        }
+        return NAV_BLOCKED;
+}
+
+int nav_shift(char direction){
+    if(direction == 'U') return 0;
+    if(direction == 'D') return 2;
+    if(direction == 'R') return 4;
+    return 6;
+}
+
+//built once after the config is loaded, so the frog, the storks and anything planning moves need just one lookup
+void build_nav_table(GameConfig *game_config){
+    memset(game_config->nav, 0, sizeof(game_config->nav));
+    for(int y = 1; y <= game_config->height; y++){
+        for(int x = 1; x <= MAX_NUM + 1; x++){
+            game_config->nav[y][x] = nav_up(game_config, x, y) << nav_shift('U')
+                                   | nav_down(game_config, x, y) << nav_shift('D')
+                                   | nav_right(game_config, x, y) << nav_shift('R')
+                                   | nav_left(game_config, x, y) << nav_shift('L');
+            if(x <= game_config->width && is_obstacle(game_config, y, x, 1) == false){
+                game_config->nav[y][x] |= NAV_STORK;
+            }
+        }
+    }
+}
+
+//NAV_BLOCKED, NAV_HALF or NAV_FULL for a jump from (x, y) in the given direction
+int nav_distance(GameConfig *game_config, int x, int y, char direction){
+    if(x < 0 || x > MAX_NUM + 1 || y < 0 || y > MAX_NUM + 1){
+        return NAV_BLOCKED;
+    }
+    return (game_config->nav[y][x] >> nav_shift(direction)) & 3;
+}
+
+//the cell where a jump from (x, y) ends
+void nav_target(GameConfig *game_config, int x, int y, char direction, int *target_x, int *target_y){
+    int distance = nav_distance(game_config, x, y, direction);
+    *target_x = x;
+    *target_y = y;
+    if(direction == 'U'){
+        *target_y -= distance / NAV_FULL;     //a full jump up or down is one row
+    }
+    else if(direction == 'D'){
+        *target_y += distance / NAV_FULL;
+    }
+    else if(direction == 'R'){
+        *target_x += distance;
+    }
+    else{
+        *target_x -= distance;
+    }
+}
+
+            //FROGS MOVES UP, DOWN, LEFT, RIGHT
+void frog_jump(GameConfig* game_config, Frog* frog, char direction, clock_t time){
+    int target_x, target_y;
+    nav_target(game_config, frog->x, frog->y, direction, &target_x, &target_y);
+    if(target_x != frog->x || target_y != frog->y){
+        frog->x = target_x;
+        frog->y = target_y;
+        frog->moves++;
+        log_event(EVENT_JUMP, 'F', direction, frog->x, frog->y, frog->moves);
+    }
+    else{
+        log_event(EVENT_BLOCKED_JUMP, 'F', direction, frog->x, frog->y, frog->moves);
+    }
+    frog->direction = direction;
+    frog->last_jump_time = time;
+}
+
+//the jump happens at the time the key was pressed
+void frogs_move(GameConfig* game_config, Frog* frog, int movement, clock_t time) {
+    if(can_frog_jump(game_config, frog, time) == false){
+        return;
+    }
+    else if(frog->is_carried == true){ //frog can't move when its being carried by a car
+        return;
+    }
+    
+    //If frog is allowed to jump, then update its position and last_jump_time for the present time (provided that it is not jumping onto an obstacle)
+    //Frog is 2x wide, that's why there are two conditions for its x
+    //We have to substract 1 from frog->y due to the board shift
+    switch (movement) {
+    case KEY_UP:
+        frog_jump(game_config, frog, 'U', time);
+        break;
+    case KEY_DOWN:
+        frog_jump(game_config, frog, 'D', time);
+        break;
+    case KEY_RIGHT:
+        frog_jump(game_config, frog, 'R', time);
+        break;
+    case KEY_LEFT:
+        frog_jump(game_config, frog, 'L', time);
+        break;
+    }
+
+}
+
+
+            //SECTION OF CARS MOVEMENT
+
+            //PARKED CARS - HIDDEN CARS WAIT IN cars[car_pool.count, car_number), SORTED BY hidden_until
+void park_car(GameConfig *game_config, Car *cars, int index){
+    despawn_car(game_config, cars, entity_handle(&game_config->car_pool, index));
+
+    //the parked car is now the first one after the live cars, it's moved back to keep the queue in order
+    for(int i = game_config->car_pool.count; i + 1 < game_config->car_number && cars[i].hidden_until > cars[i + 1].hidden_until; i++){
+        Car temp = cars[i];
+        cars[i] = cars[i + 1];
+        cars[i + 1] = temp;
+    }
+}
+
+void respawn_cars(GameConfig *game_config, Car *cars, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    while(game_config->car_pool.count < game_config->car_number && game_clock() >= cars[game_config->car_pool.count].hidden_until){
+        Car *car = &cars[spawn_entity(&game_config->car_pool)];
+        car->hidden = false;
+        change_car_position(car, game_config, roads_pos, cars_on_lane, free_lanes, lane_directions);
+        car->prev_x = car->x;
+        car->prev_y = car->y;
+        car->last_move_time = game_clock() - car->delay * CLOCKS_PER_SEC / 1000;     //it makes its first move right away
+        log_event(EVENT_CAR_RESPAWN, car->car_type, 0, car->x, car->y, car->delay);
+    }
+}
+
+void manage_lanes(GameConfig *game_config, Car *car, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    int current_lane = -1;
+    for(int i = 0; i < game_config->road_lanes; i++){
+        if(car->y == (roads_pos[i] + 1)){ 
+            current_lane = i;
+            break;
+        }
+    }
+
+    //counting how many cars are on the lanes and how many lanes without cars there are
+    cars_on_lane[current_lane]--;
+            if(cars_on_lane[current_lane] == 0){
+                (*free_lanes)++;
+            }
+            car->hidden = true;
+            int hidden_time = game_rand(game_config) % 1000 + 500;                                         //random delay between 0.5 and 1.5 seconds
+            car->hidden_until = game_clock() + hidden_time * CLOCKS_PER_SEC / 1000;
+            log_event(EVENT_CAR_HIDE, car->car_type, 0, car->x, car->y, hidden_time);
+            car->x = game_config->width + 5;                                                               //placing car outside of the board so the frog won't step into it by an accident
+            car->y = game_config->height + 5;
+}
+
+                //WHAT HAPPENS TO A CAR WHEN IT HITS THE BORDER
+bool hits_the_border(GameConfig *game_config, Car *car){
+    if(car->x <= 1 || (car->x + CAR_WIDTH - 2) >= game_config->width){
+        return true;
+    }
+    else{
+        return false;
+    }
+}
+
+void cars_destiny(GameConfig *game_config, Car* car, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    if(game_rand(game_config) % 3 == 0){
+                if(car->direction == 1){
+                    car->x = 1;
+                }
+                else{
+                    car->x = game_config->width - CAR_WIDTH;
+                }                                                                                               //the car wrapps (33% chance)
+            }
+            else{                                                                                               //the car changes lane (66% chance)
+                manage_lanes(game_config, car, roads_pos, cars_on_lane, free_lanes, lane_directions);
+            }
+    //wrapping or leaving the lane is a jump, not a move, so the car is not swept across the whole lane
+    car->prev_x = car->x;
+    car->prev_y = car->y;
+}
+
+//MAIN FUNCTION OF CARS POSITION
+
+bool cars_friendly_and_neutral_move(GameConfig *game_config, Frog *frog, Car *car){
+    //friendly and neutral cars dont move when the frog is close and directed to them
+    if (frog->direction == 'U' && (frog->y >= car->y)) {
+        return false;
+    }
+    else if (frog->direction == 'D' && frog->y <= car->y + 1) {
+        return false;
+    }
+    if (frog->direction == 'L' && (frog->x + 1 < car->x && car->direction == -1) || (frog->x > car->x + CAR_WIDTH - 1 && car->direction == 1)) {
+        if(frog->y == car->y || frog->y == car->y + 1){
+            return false;
+        }
+    }
+    if (frog->direction == 'R' && (frog->x + 2 >= car->x && car->direction == -1) || (frog->x >= car->x + CAR_WIDTH - 1 && car->direction == 1)) {
+        if(frog->y == car->y || frog->y == car->y + 1){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_shant(GameConfig *game_config, Car *car){
+    //the cell right in front of the car is taken by another one
+    int front_x;
+    if(car->direction == 1){
+        front_x = car->x + CAR_WIDTH;
+    }
+    else{
+        front_x = car->x - 1;
+    }
+    return any_bits(game_config->board.cars[car->y - 1], front_x - 1, 1);
+}
+
+template<int MODE>
+void update_car_pos(GameConfig *game_config, Car *car, Frog *frog, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    if(((MODE & MODE_NEUTRAL_CARS) && car->car_type == 'n' && is_any_frog_near<MODE>(game_config, frog, car)) || ((MODE & MODE_FRIENDLY_CARS) && car->car_type == 'f' && is_any_frog_near<MODE>(game_config, frog, car) && car->carrying_frog == false)){
+        //if(cars_friendly_and_neutral_move(game_config, frog, car) == false){
+        return;
+        //}
+    }
+
+    if(is_shant(game_config, car) == true){ //if a car would ride "into" a car that is ahead of it then stop its movement
+        return;
+    }
+
+    if(!(MODE & MODE_FRIENDLY_CARS) || car->carrying_frog == false){
+        car->x += car->direction;
+
+        if(hits_the_border(game_config, car) == true){
+            cars_destiny(game_config, car, roads_pos, cars_on_lane, free_lanes, lane_directions);
+        }
+    }
+    else{                                  //when a car carries the frog then it can't dissapear when close to the border, it has to wait for frog to get out of the car
+         if(car->x + 1 > 1 && (car->x + CAR_WIDTH - 1) < game_config->width){
+            car->x += car->direction;
+        }
+        else{
+            return;
+        }
+    }
+}
+
+void change_car_delay(GameConfig *game_config, Car *car){
+    if(game_clock() >= car->until_delay_change){
+        car->delay = (game_rand(game_config) % (game_config->max_car_delay - game_config->min_car_delay)) + game_config->min_car_delay;
+        log_event(EVENT_DELAY_CHANGE, car->car_type, 0, car->x, car->y, car->delay);
+        car->until_delay_change = game_clock() + ((game_rand(game_config) % DELAY_CHANGE_T) + DELAY_CHANGE_T) * CLOCKS_PER_SEC / 1000;
+    }
+}
+
+bool is_frog_hit_by_car(Frog *frog, Car *car);
+
+//only a frog that has been in a friendly car can be carried or invincible
+template<int MODE>
+bool can_frog_be_hit(Frog *frog){
+    if(MODE & MODE_FRIENDLY_CARS){
+        return frog->is_carried == false && frog->is_invincible == false;
+    }
+    return true;
+}
+
+//how many cells the car should have travelled since its last move (its speed is independent of the frame rate)
+int car_steps_due(Car *car){
+    int elapsed = (game_clock() - car->last_move_time) * 1000 / CLOCKS_PER_SEC;
+    return elapsed / car->delay;
+}
+
+template<int MODE>
+void cars_move(GameConfig *game_config, Car* cars, Frog* frog, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    respawn_cars(game_config, cars, roads_pos, cars_on_lane, free_lanes, lane_directions);
+    rebuild_cars_plane(game_config, cars);
+    for(int i = 0; i < game_config->car_pool.count; i++){
+        cars[i].prev_x = cars[i].x;
+        cars[i].prev_y = cars[i].y;
+
+        int steps = car_steps_due(&cars[i]);
+        if(steps == 0){
+            continue;
+        }
+
+        //the leftover time is carried over to the next frame, unless the car is too far behind
+        if(steps > MAX_CAR_STEPS){
+            steps = MAX_CAR_STEPS;
+            cars[i].last_move_time = game_clock();
+        }
+        else{
+            cars[i].last_move_time += steps * cars[i].delay * CLOCKS_PER_SEC / 1000;
+        }
+
+        //the car goes through every cell on its way, so it can still stop behind a car or run the frog over in the middle of a frame
+        for(int step = 0; step < steps; step++){
+            car_cells(&cars[i], false, game_config);
+            update_car_pos<MODE>(game_config, &cars[i], frog, roads_pos, cars_on_lane, free_lanes, lane_directions);
+            car_cells(&cars[i], true, game_config);
+            if(cars[i].hidden == true){
+                break;
+            }
+            //the frogs of a crowd are checked once the cars have moved, through the cars index
+            if(!(MODE & MODE_CROWD) && can_frog_be_hit<MODE>(frog) && is_frog_hit_by_car(frog, &cars[i]) == true){
+                break;
+            }
+        }
+
+        //checks whether enought time has passed for car to have another delay (meaning another speed)
+        change_car_delay(game_config, &cars[i]);
+
+        if(cars[i].hidden == true){
+            park_car(game_config, cars, i);
+            i--;        //the last live car took its place and hasn't moved yet
+        }
+    }
+}
+
+            //CARS INDEX - WITH MANY FROGS A FROG ONLY LOOKS AT THE CARS IN THE CELLS AROUND IT
+//the cells of a row follow each other in order[], so the cars of a row between two columns are one range
+size_t car_index_bytes(GameConfig *game_config){
+    int columns = game_config->width / CROWD_BUCKET + 2;
+    return arena_aligned(((MAX_NUM + 2) * columns + 1) * sizeof(int)) + arena_aligned(game_config->car_number * sizeof(int));
+}
+
+void init_car_index(CarIndex *index, GameConfig *game_config, Arena *arena){
+    index->columns = game_config->width / CROWD_BUCKET + 2;
+    index->first = (int*)arena_alloc(arena, ((MAX_NUM + 2) * index->columns + 1) * sizeof(int));
+    index->order = (int*)arena_alloc(arena, game_config->car_number * sizeof(int));
+}
+
+//cars that stick out of the board are kept in the first and the last column
+int index_cell(CarIndex *index, int x, int y){
+    int column = x < 0 ? 0 : x / CROWD_BUCKET;
+    if(column >= index->columns){
+        column = index->columns - 1;
+    }
+    if(y < 0) y = 0;
+    if(y > MAX_NUM + 1) y = MAX_NUM + 1;
+    return y * index->columns + column;
+}
+
+//counting sort of the live cars by their cell, O(cars + cells)
+void build_car_index(CarIndex *index, GameConfig *game_config, Car *cars){
+    int cells = (MAX_NUM + 2) * index->columns;
+    memset(index->first, 0, (cells + 1) * sizeof(int));
+    for(int i = 0; i < game_config->car_pool.count; i++){
+        index->first[index_cell(index, cars[i].x, cars[i].y) + 1]++;
+    }
+    for(int c = 0; c < cells; c++){
+        index->first[c + 1] += index->first[c];
+    }
+    //first[c] is moved to the end of cell c while it's filled, then everything is shifted back by one cell
+    for(int i = 0; i < game_config->car_pool.count; i++){
+        index->order[index->first[index_cell(index, cars[i].x, cars[i].y)]++] = i;
+    }
+    for(int c = cells; c > 0; c--){
+        index->first[c] = index->first[c - 1];
+    }
+    index->first[0] = 0;
+}
+
+//cars of the row with x in [low_x, high_x] are among order[begin, end), with some more from the same cells
+void indexed_cars(CarIndex *index, int y, int low_x, int high_x, int *begin, int *end){
+    if(y < 0 || y > MAX_NUM + 1 || low_x > high_x){
+        *begin = *end = 0;
+        return;
+    }
+    *begin = index->first[index_cell(index, low_x, y)];
+    *end = index->first[index_cell(index, high_x, y) + 1];
+}
+
+//the same swept test as check_collision, only with the cars that can be that close
+template<int MODE>
+bool is_indexed_frog_hit(Frog *frog, Car *cars, CarIndex *index){
+    if(can_frog_be_hit<MODE>(frog) == false){
+        return false;
+    }
+    int low_y = frog->prev_y < frog->y ? frog->prev_y : frog->y;
+    int high_y = frog->prev_y < frog->y ? frog->y : frog->prev_y;
+    int low_x = frog->prev_x < frog->x ? frog->prev_x : frog->x;
+    int high_x = frog->prev_x < frog->x ? frog->x : frog->prev_x;
+    for(int row = low_y - CAR_HEIGHT + 1; row <= high_y; row++){
+        int begin, end;
+        indexed_cars(index, row, low_x - CAR_WIDTH - MAX_CAR_STEPS, high_x + 2 + MAX_CAR_STEPS, &begin, &end);
+        for(int i = begin; i < end; i++){
+            if(is_frog_hit_by_car(frog, &cars[index->order[i]]) == true){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+            //ENDLESS MODE - THE BOARD SCROLLS DOWN AS THE FROG GOES UP
+//the board keeps its height rows: two of them are dropped at the bottom and two new ones are made at the top,
+//so a scroll costs the same and the level takes the same memory however far the frog gets
+void generate_row(GameConfig *game_config, int row, bool road, bool obstacles){
+    BoardPlanes *board = &game_config->board;
+    clear_board_row(board, row);
+    if(road == true){
+        set_bits(board->road[row], 0, game_config->width);
+        return;
+    }
+    set_bits(board->grass[row], 0, game_config->width);
+
+    //a run of obstacles takes at most a third of the row, the frog walks around it on the row below
+    int longest = game_config->width / 3;
+    if(obstacles == true && longest >= 2 && game_rand(game_config) % 100 < ENDLESS_OBSTACLE_CHANCE){
+        int length = game_rand(game_config) % (longest - 1) + 2;
+        int start = game_rand(game_config) % (game_config->width - length + 1);
+        clear_bits(board->grass[row], start, length);
+        set_bits(board->obstacle[row], start, length);
+    }
+}
+
+//moves everything two rows down; the lane tables are kept in the order of the lanes on the board, top first
+void scroll_board(GameConfig *game_config, Frog *frog, Car *cars, Stork *storks, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    BoardPlanes *board = &game_config->board;
+    int rows = game_config->height - 2;
+    memmove(board->road[2], board->road[0], rows * sizeof(board->road[0]));
+    memmove(board->grass[2], board->grass[0], rows * sizeof(board->grass[0]));
+    memmove(board->obstacle[2], board->obstacle[0], rows * sizeof(board->obstacle[0]));
+
+    //the lowest lane goes off the board, its cars are hidden and come back on the other lanes
+    int last = game_config->road_lanes - 1;
+    if(last >= 0 && roads_pos[last] + 3 >= game_config->height){
+        for(int i = 0; i < game_config->car_pool.count; i++){
+            if(cars[i].y == roads_pos[last] + 1){
+                manage_lanes(game_config, &cars[i], roads_pos, cars_on_lane, free_lanes, lane_directions);
+                park_car(game_config, cars, i);
+                i--;
+            }
+        }
+        (*free_lanes)--;        //the lane is empty now, and it's gone
+        game_config->road_lanes--;
+    }
+
+    for(int i = 0; i < game_config->road_lanes; i++){
+        roads_pos[i] += 2;
+    }
+    for(int i = 0; i < game_config->car_pool.count; i++){
+        cars[i].y += 2;
+        cars[i].prev_y += 2;
+    }
+    for(int i = 0; i < game_config->stork_count; i++){
+        storks[i].y += 2;
+        storks[i].prev_y += 2;
+        check_whether_in_board(game_config, &storks[i]);
+    }
+    frog->y += 2;
+    frog->prev_y += 2;
+
+    bool road;
+    if(game_config->map != NULL){
+        //the map is climbed from its last row up, and from the bottom again once the frog gets to the top
+        RunBoard *map = game_config->map;
+        int lower = map->height - 1 - game_config->distance % map->height;
+        int upper = (lower + map->height - 1) % map->height;
+        stamp_run_row(game_config, 1, map, lower);
+        stamp_run_row(game_config, 0, map, upper);
+        road = any_bits(game_config->board.road[0], 0, 1);
+    }
+    else{
+        road = game_rand(game_config) % 100 < ENDLESS_ROAD_CHANCE;
+    }
+    //a board without roads would have nowhere to put the cars
+    if(road == false && game_config->road_lanes == 0){
+        road = true;
+    }
+    if(game_config->map == NULL || any_bits(game_config->board.road[0], 0, 1) != road){
+        generate_row(game_config, 0, road, true);
+        generate_row(game_config, 1, road, false);
+    }
+    if(road == true){
+        memmove(roads_pos + 1, roads_pos, game_config->road_lanes * sizeof(int));
+        memmove(cars_on_lane + 1, cars_on_lane, game_config->road_lanes * sizeof(int));
+        memmove(lane_directions + 1, lane_directions, game_config->road_lanes * sizeof(int));
+        roads_pos[0] = 0;
+        cars_on_lane[0] = 0;
+        lane_directions[0] = game_rand(game_config) % 2 == 0 ? 1 : -1;
+        game_config->road_lanes++;
+        (*free_lanes)++;
+    }
+
+    game_config->distance += 2;
+    build_nav_table(game_config);
+    rebuild_cars_plane(game_config, cars);
+    game_config->flow.frog_x = -1;
+    game_config->flow.frog_y = -1;
+}
+
+
+// INPUT SECTION - KEYS ARE READ BY THEIR OWN THREAD
+            //the thread reads the terminal directly (curses isn't thread safe), so arrows have to be decoded here
+            //returns the key, ERR if the bytes mean nothing to the game; *used is 0 if the escape sequence isn't complete yet
+int decode_key(unsigned char buffer[], int length, int *used){
+    if(buffer[0] != 27){
+        *used = 1;
+        return buffer[0];
+    }
+    if(length < 3){
+        *used = 0;
+        return ERR;
+    }
+    *used = 3;
+    if(buffer[1] != '[' && buffer[1] != 'O'){
+        return ERR;
+    }
+    switch(buffer[2]){
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+    }
+    return ERR;
+}
+
+void push_key(InputQueue *input, int key, clock_t time){
+    unsigned int tail = input->tail.load(std::memory_order_relaxed);
+    if(tail - input->head.load(std::memory_order_acquire) == INPUT_QUEUE_SIZE){
+        return;             //the game is too far behind, the key is dropped
+    }
+    input->events[tail % INPUT_QUEUE_SIZE].key = key;
+    input->events[tail % INPUT_QUEUE_SIZE].time = time;
+    input->tail.store(tail + 1, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(input->wake_mutex);
+    input->wake.notify_one();
+}
+
+bool pop_key(InputQueue *input, KeyEvent *event){
+    unsigned int head = input->head.load(std::memory_order_relaxed);
+    if(head == input->tail.load(std::memory_order_acquire)){
+        return false;
+    }
+    *event = input->events[head % INPUT_QUEUE_SIZE];
+    input->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void read_keys(InputQueue *input){
+    unsigned char buffer[32];
+    int length = 0;
+    while(input->running.load()){
+        struct pollfd terminal = {0, POLLIN, 0};
+        if(poll(&terminal, 1, INPUT_POLL_TIME) <= 0){
+            length = 0;     //a lonely escape, nothing more is coming
+            continue;
+        }
+        int count = read(0, buffer + length, sizeof(buffer) - length);
+        if(count <= 0){
+            continue;
+        }
+        clock_t time = game_clock();
+        length += count;
+
+        int start = 0;
+        while(start < length){
+            int used;
+            int key = decode_key(buffer + start, length - start, &used);
+            if(used == 0){
+                break;
+            }
+            if(key != ERR){
+                push_key(input, key, time);
+            }
+            start += used;
+        }
+        memmove(buffer, buffer + start, length - start);
+        length -= start;
+    }
+}
+
+void start_input(InputQueue *input){
+    input->head.store(0);
+    input->tail.store(0);
+    input->has_buffered = false;
+    input->running.store(true);
+    input->reader = std::thread(read_keys, input);
+}
+
+//has to be called before anything else reads the keyboard with curses
+void stop_input(InputQueue *input){
+    input->running.store(false);
+    if(input->reader.joinable()){
+        input->reader.join();
+    }
+}
+
+//sleeps until the time given (in game_clock() units) or until a key is pressed, whichever comes first
+void wait_for_input(InputQueue *input, clock_t until){
+    long long microseconds = (long long)(until - game_clock()) * 1000000 / CLOCKS_PER_SEC;
+    if(microseconds <= 0){
+        return;
+    }
+    std::unique_lock<std::mutex> lock(input->wake_mutex);
+    input->wake.wait_for(lock, std::chrono::microseconds(microseconds), [input]{
+        return input->head.load() != input->tail.load();
+    });
+}
+
+bool is_arrow(int key){
+    return key == KEY_UP || key == KEY_DOWN || key == KEY_LEFT || key == KEY_RIGHT;
+}
+
+//next key for the game; an arrow pressed up to jump_buffer ms too early is held back until the frog can jump
+bool next_key(InputQueue *input, Frog *frog, KeyEvent *event){
+    if(input->has_buffered == true && game_clock() >= frogs_next_jump(frog)){
+        input->has_buffered = false;
+        *event = input->buffered;
+        event->time = frogs_next_jump(frog);
+        return true;
+    }
+    while(pop_key(input, event)){
+        if(is_arrow(event->key) && frog->is_carried == false && event->time < frogs_next_jump(frog)){
+            if(event->time + frog->jump_buffer * CLOCKS_PER_SEC / 1000 >= frogs_next_jump(frog)){
+                input->has_buffered = true;
+                input->buffered = *event;
+            }
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+
+// MAIN GAME CONDITIONS - WHETHER FROG IS STILL ALIVE OR NOT
+
+void update_invincibility(Frog *frog) {
+    if (frog->is_invincible) {
+        if ((game_clock() - frog->invincibility_start) * 1000 / CLOCKS_PER_SEC >= INVINCIBILITY_TIME) { 
+            frog->is_invincible = false;
+        }
+    }
+}
+
+//entry and exit time (as a fraction of the frame) of a moving distance d into the open range (low, high)
+void swept_axis(int d0, int d1, int low, int high, double *t_enter, double *t_exit){
+    if(d0 == d1){
+        if(d0 > low && d0 < high){
+            *t_enter = -1.0;
+            *t_exit = 2.0;
+        }
+        else{
+            *t_enter = 2.0;
+            *t_exit = -1.0;
+        }
+        return;
+    }
+    double t_low = (double)(low - d0) / (d1 - d0);
+    double t_high = (double)(high - d0) / (d1 - d0);
+    if(t_low < t_high){
+        *t_enter = t_low;
+        *t_exit = t_high;
+    }
+    else{
+        *t_enter = t_high;
+        *t_exit = t_low;
+    }
+}
+
+//both boxes move in a straight line from (x0, y0) to (x1, y1) during the frame,
+//they collide if they overlap at any moment of it, so fast entities can't pass through each other between two frames
+bool swept_boxes_hit(int a_x0, int a_y0, int a_x1, int a_y1, int a_width, int a_height, int b_x0, int b_y0, int b_x1, int b_y1, int b_width, int b_height){
+    double x_enter, x_exit, y_enter, y_exit;
+    swept_axis(a_x0 - b_x0, a_x1 - b_x1, -a_width, b_width, &x_enter, &x_exit);
+    swept_axis(a_y0 - b_y0, a_y1 - b_y1, -a_height, b_height, &y_enter, &y_exit);
+
+    double enter = x_enter > y_enter ? x_enter : y_enter;
+    double exit = x_exit < y_exit ? x_exit : y_exit;
+    if(enter < exit && enter < 1.0 && exit > 0.0){
+        return true;
+    }
+    return false;
+}
+
+bool is_frog_hit_by_car(Frog *frog, Car *car){
+    return swept_boxes_hit(frog->prev_x, frog->prev_y, frog->x, frog->y, 2, 1,
+                           car->prev_x, car->prev_y, car->x, car->y, CAR_WIDTH, CAR_HEIGHT);
+}
+
+template<int MODE>
+bool check_collision(Frog *frog, Car *cars, GameConfig *game_config){
+    if(can_frog_be_hit<MODE>(frog) == false){
+        return false;
+    }
+    //cars never leave their lane while moving, so if there are no cars in the frogs rows there is nothing to test
+    if(is_row_clear(game_config->board.cars[frog->y - 1]) && is_row_clear(game_config->board.cars[frog->prev_y - 1])){
+        return false;
+    }
+
+    for(int i = 0; i < game_config->car_pool.count; i++){
+        if(is_frog_hit_by_car(frog, &cars[i]) == true){
+            return true;
+        }
+    }
+    return false;
+}
+
+//w - the frog got to the other side, c - hit by a car, s - caught by a stork, n - the round goes on
+template<int MODE>
+char round_result(GameConfig *game_config, Frog *frog, Car *cars, Stork *storks){
+    if (!(MODE & MODE_ENDLESS) && frog->y == 1) {      //an endless board has no other side
+        return 'w';
+    }
+    if(check_collision<MODE>(frog, cars, game_config) == true){
+        return 'c';
+    }
+    if ((MODE & MODE_STORKS) && check_storks_collision(game_config, frog, storks)) {
+        return 's';
+    }
+    return 'n';
+}
+
+template<int MODE>
+char check_game_status(GameConfig* game_config, Frog* frog, Car* cars, Stork *storks) {           //n - nothing's changed; c, s - game lost; w - game won
+    char result = round_result<MODE>(game_config, frog, cars, storks);
+    if(result == 'c' || result == 's'){
+        log_event(EVENT_DEATH, 'F', result, frog->x, frog->y, frog->moves);
+    }
+    return result;
+}
+
+            //END OF THE ROUND - THE RESULT, THE NAME AND THE SCORE, WITHOUT STOPPING THE LOOP
+void begin_round_end(RoundEnd *end, WINDOW* game_window, GameConfig* game_config, Frog* frog, Renderer *renderer, char result, int time_elapsed){
+    stop_renderer(renderer);
+    end->result = result;
+    end->typing = false;
+    end->name[0] = '\0';
+    end->name_length = 0;
+    if (result == 'w') {
+        mvwprintw(game_window, game_config->height / 2, game_config->width / 2 - 5, "YOU WON!");
+        wrefresh(game_window);
+        calculate_score(time_elapsed, frog);
+        log_event(EVENT_SCORE, 'F', 'w', frog->x, frog->y, frog->score);
+        end->typing = true;
+        show_name_prompt(frog, end->name);
+        return;
+    }
+    if(result == 'c'){
+        mvwprintw(game_window, game_config->height / 2, game_config-> width /2 - 11, "GAME OVER!\tYOU LOST!");
+    }
+    else{
+        mvwprintw(game_window, game_config->height / 2, game_config->width / 2 - 11, "GAME OVER!\tSTORK GOT YOU!");
+    }
+    wrefresh(game_window);
+    end->until = game_clock() + LOSS_SCREEN_TIME * CLOCKS_PER_SEC / 1000;
+}
+
+//takes the keys typed since the last frame; true once the round is over for good
+bool step_round_end(RoundEnd *end, Frog *frog, InputQueue *input, ScoreWriter *scores){
+    KeyEvent event;
+    if(end->typing == false){
+        while(pop_key(input, &event)){
+            //nothing to type anymore
+        }
+        return game_clock() >= end->until;
+    }
+    while(end->typing == true && pop_key(input, &event)){
+        if(event.key == '\n' || event.key == '\r'){
+            end->typing = false;
+            queue_score(scores, end->name, frog->score);       //written by the score writer while the result is still shown
+            end->until = game_clock() + WIN_SCREEN_TIME * CLOCKS_PER_SEC / 1000;
+        }
+        else if((event.key == 127 || event.key == 8) && end->name_length > 0){
+            end->name[--end->name_length] = '\0';
+        }
+        else if(event.key >= ' ' && event.key < 127 && end->name_length < MAX_NUM - 1){
+            end->name[end->name_length++] = event.key;
+            end->name[end->name_length] = '\0';
+        }
+    }
+    show_name_prompt(frog, end->name);
+    return false;
+}
+
+//MAIN GAME LOOP
+
+            //FROG AND FRIENDLY CARS
+Car *find_near_friendly_car(GameConfig *game_config, Frog* frog, Car *cars){
+    Car *car = NULL;
+    for(int i = 0; i < game_config->car_pool.count; i++){
+        if(cars[i].car_type == 'f'){
+            if(is_frog_near(frog, &cars[i]) == true){
+                car = &cars[i];
+            }
+        }
+    }
+
+    return car;
+}
+
+void frog_gets_in_the_car(GameConfig *game_config, Frog *frog, Car *cars, Car *friendly_car){
+    if(friendly_car != NULL){
+        friendly_car->carrying_frog = true;
+        frog->is_carried = true;
+        frog->x = game_config->width / 2;
+        frog->y = game_config->height + 1;
+        frog->prev_x = frog->x;         //getting in is not a move, nothing should be swept along the way to the car
+        frog->prev_y = frog->y;
+        frog->frogs_car = entity_handle(&game_config->car_pool, friendly_car - cars);
+        log_event(EVENT_ENTER_CAR, 'F', 0, friendly_car->x, friendly_car->y, frog->moves);
+    }
+    else{
+        return;
+    }
+}
+
+void frog_gets_out_of_the_car(GameConfig *game_config, Frog *frog, Car *cars){
+    Car *frogs_car = get_car(game_config, cars, frog->frogs_car);
+    if(frogs_car != NULL){
+        frogs_car->carrying_frog = false;
+        frog->is_carried = false;
+        if(frogs_car->direction == 1){
+            frog->x = frogs_car->x - 1;
+        }
+        else{
+            frog->x = frogs_car->x + CAR_WIDTH + 1;
+        }
+        frog->y = frogs_car->y;
+        frog->is_invincible = true;
+        frog->invincibility_start = game_clock();
+        frog->prev_x = frog->x;
+        frog->prev_y = frog->y;
+        log_event(EVENT_LEAVE_CAR, 'F', 0, frog->x, frog->y, frog->moves);
+        
+        frog->frogs_car = no_handle();
+        return;
+    }
+    else{
+        return;
+    }
+}
+
+            //GAME STATE - THE WHOLE SIMULATION COPIED INTO ONE FLAT BUFFER AND BACK
+//entities refer to each other with handles, not pointers, so the bytes can be copied as they are
+//the cars plane and the flow field are not saved, they're computed again from the cars and the frog
+//an endless board changes while it's played, so its fields and lanes are saved too
+size_t state_pool_bytes(int capacity){
+    return sizeof(int) + 3 * capacity * sizeof(int);
+}
+
+size_t game_state_bytes(GameConfig *game_config){
+    return sizeof(StateHeader) + MAX_FROGS * sizeof(Frog)
+         + state_pool_bytes(MAX_FROGS) + state_pool_bytes(game_config->car_number) + state_pool_bytes(game_config->stork_count)
+         + game_config->car_number * sizeof(Car) + game_config->stork_count * sizeof(Stork)
+         + 2 * lane_capacity(game_config) * sizeof(int)
+         + (game_config->endless == true ? 3 * sizeof(game_config->board.road) + lane_capacity(game_config) * sizeof(int) : 0);
+}
+
+void put_bytes(char **out, const void *data, size_t size){
+    memcpy(*out, data, size);
+    *out += size;
+}
+
+void get_bytes(const char **in, void *data, size_t size){
+    memcpy(data, *in, size);
+    *in += size;
+}
+
+void save_pool(char **out, EntityPool *pool){
+    put_bytes(out, &pool->count, sizeof(int));
+    put_bytes(out, pool->generation, pool->capacity * sizeof(int));
+    put_bytes(out, pool->dense, pool->capacity * sizeof(int));
+    put_bytes(out, pool->slots, pool->capacity * sizeof(int));
+}
+
+void restore_pool(const char **in, EntityPool *pool){
+    get_bytes(in, &pool->count, sizeof(int));
+    get_bytes(in, pool->generation, pool->capacity * sizeof(int));
+    get_bytes(in, pool->dense, pool->capacity * sizeof(int));
+    get_bytes(in, pool->slots, pool->capacity * sizeof(int));
+}
+
+//state has to have game_state_bytes(game_config) bytes
+void save_game_state(char *state, GameConfig *game_config, Frog *frogs, Car *cars, Stork *storks, clock_t start_time, int roads_pos[], int cars_on_lane[], int free_lanes, int lane_directions[]){
+    StateHeader header;
+    header.saved_at = game_clock();
+    header.start_time = start_time;
+    header.rng = game_config->rng;
+    header.car_number = game_config->car_number;
+    header.stork_count = game_config->stork_count;
+    header.lane_capacity = lane_capacity(game_config);
+    header.road_lanes = game_config->road_lanes;
+    header.free_lanes = free_lanes;
+    header.distance = game_config->distance;
+
+    char *out = state;
+    put_bytes(&out, &header, sizeof(header));
+    put_bytes(&out, frogs, MAX_FROGS * sizeof(Frog));
+    save_pool(&out, &game_config->frog_pool);
+    save_pool(&out, &game_config->car_pool);
+    save_pool(&out, &game_config->stork_pool);
+    put_bytes(&out, cars, game_config->car_number * sizeof(Car));
+    put_bytes(&out, storks, game_config->stork_count * sizeof(Stork));
+    put_bytes(&out, cars_on_lane, header.lane_capacity * sizeof(int));
+    put_bytes(&out, lane_directions, header.lane_capacity * sizeof(int));
+    if(game_config->endless == true){
+        put_bytes(&out, game_config->board.road, sizeof(game_config->board.road));
+        put_bytes(&out, game_config->board.grass, sizeof(game_config->board.grass));
+        put_bytes(&out, game_config->board.obstacle, sizeof(game_config->board.obstacle));
+        put_bytes(&out, roads_pos, header.lane_capacity * sizeof(int));
+    }
+}
+
+//moves every timer of the game by shift, so they run on from where they were when the state was saved
+void shift_clocks(GameConfig *game_config, Frog *frogs, Car *cars, Stork *storks, clock_t *start_time, clock_t shift){
+    *start_time += shift;
+    for(int i = 0; i < game_config->frog_pool.count; i++){
+        frogs[i].last_jump_time += shift;
+        frogs[i].invincibility_start += shift;
+    }
+    for(int i = 0; i < game_config->car_number; i++){
+        cars[i].last_move_time += shift;
+        cars[i].hidden_until += shift;
+        cars[i].until_delay_change += shift;
+    }
+    for(int i = 0; i < game_config->stork_count; i++){
+        storks[i].last_move_time += shift;
+    }
+}
+
+//resume == false puts the game back exactly as it was (rollback), resume == true also moves the timers by the time
+//that has passed since saving (pause); returns false if the state was saved for a differently sized level
+bool restore_game_state(const char *state, GameConfig *game_config, Frog *frogs, Car *cars, Stork *storks, clock_t *start_time, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[], bool resume){
+    const char *in = state;
+    StateHeader header;
+    get_bytes(&in, &header, sizeof(header));
+    if(header.car_number != game_config->car_number || header.stork_count != game_config->stork_count || header.lane_capacity != lane_capacity(game_config)){
+        return false;
+    }
+
+    get_bytes(&in, frogs, MAX_FROGS * sizeof(Frog));
+    restore_pool(&in, &game_config->frog_pool);
+    restore_pool(&in, &game_config->car_pool);
+    restore_pool(&in, &game_config->stork_pool);
+    get_bytes(&in, cars, game_config->car_number * sizeof(Car));
+    get_bytes(&in, storks, game_config->stork_count * sizeof(Stork));
+    get_bytes(&in, cars_on_lane, header.lane_capacity * sizeof(int));
+    get_bytes(&in, lane_directions, header.lane_capacity * sizeof(int));
+    if(game_config->endless == true){
+        get_bytes(&in, game_config->board.road, sizeof(game_config->board.road));
+        get_bytes(&in, game_config->board.grass, sizeof(game_config->board.grass));
+        get_bytes(&in, game_config->board.obstacle, sizeof(game_config->board.obstacle));
+        get_bytes(&in, roads_pos, header.lane_capacity * sizeof(int));
+        build_nav_table(game_config);
+    }
+    game_config->road_lanes = header.road_lanes;
+    game_config->distance = header.distance;
+    game_config->rng = header.rng;
+    *free_lanes = header.free_lanes;
+    *start_time = header.start_time;
+
+    if(resume == true){
+        shift_clocks(game_config, frogs, cars, storks, start_time, game_clock() - header.saved_at);
+    }
+    rebuild_cars_plane(game_config, cars);
+    game_config->flow.frog_x = -1;
+    game_config->flow.frog_y = -1;
+    return true;
+}
+
+//the game stands still until p is pressed again, then its timers are moved by the length of the pause
+//q still quits from the pause, every other key is dropped
+char pause_game(GameConfig *game_config, Frog *frog, Car *cars, Stork *storks, Renderer *renderer, InputQueue *input, clock_t *start_time, int time_elapsed){
+    publish_snapshot(renderer, game_config, frog, cars, storks, time_elapsed, true);
+    clock_t paused_at = game_clock();
+    input->has_buffered = false;
+    KeyEvent event;
+    for(;;){
+        wait_for_input(input, game_clock() + INPUT_POLL_TIME * CLOCKS_PER_SEC / 1000);
+        if(pop_key(input, &event) && (event.key == 'p' || event.key == 'q')){
+            break;
+        }
+    }
+    if(event.key == 'q'){
+        return 'q';
+    }
+    shift_clocks(game_config, frog, cars, storks, start_time, game_clock() - paused_at);
+    return 'p';
+}
+
+//q and p are left to the caller, every other key is done right away
+template<int MODE>
+char apply_key(GameConfig *game_config, Frog *frog, Car *cars, int movement, clock_t time){
+    if (movement == 'q') {
+        return 'q';
+    }
+    else if(movement == 'p'){
+        return 'p';
+    }
+    else if ((MODE & MODE_FRIENDLY_CARS) && movement == 'i' && frog->is_carried == false){
+        Car *friendly_car = find_near_friendly_car(game_config, frog, cars);        //if there is a friendly car in proximity of the frog then it is being saved into this variable
+        frog_gets_in_the_car(game_config, frog, cars, friendly_car);
+    }
+    else if((MODE & MODE_FRIENDLY_CARS) && movement == 'o'){
+        frog_gets_out_of_the_car(game_config, frog, cars);
+    }
+    else{
+        frogs_move(game_config, frog, movement, time);
+    }
+    return 'n';
+}
+
+//everything that moves by itself
+template<int MODE>
+void game_step(GameConfig *game_config, Frog *frog, Car *cars, Stork *storks, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    if(MODE & MODE_ENDLESS){
+        //the frog is kept in the lower two thirds of the board (a frog in a car is below it)
+        while(frog->y <= game_config->height / 3){
+            scroll_board(game_config, frog, cars, storks, roads_pos, cars_on_lane, free_lanes, lane_directions);
+        }
+    }
+    cars_move<MODE>(game_config, cars, frog, roads_pos, cars_on_lane, free_lanes, lane_directions);
+    if(MODE & MODE_STORKS){
+        move_storks(game_config, storks, frog);
+    }
+    if(MODE & MODE_FRIENDLY_CARS){
+        update_invincibility(frog);
+    }
+}
+
+template<int MODE>
+char game_update(GameConfig* game_config, Frog* frog, Car *cars, Stork* storks, InputQueue *input, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    event_clock = game_clock();
+    frog->prev_x = frog->x;
+    frog->prev_y = frog->y;
+
+    //every key pressed since the last frame is used, in the order and at the time it was pressed
+    KeyEvent event;
+    while(next_key(input, frog, &event)){
+        char command = apply_key<MODE>(game_config, frog, cars, event.key, event.time);
+        if(command != 'n'){
+            return command;
+        }
+    }
+    
+    game_step<MODE>(game_config, frog, cars, storks, roads_pos, cars_on_lane, free_lanes, lane_directions);
+    return 'n';
+}
+
+//the simulation keeps a fixed rate of frames, and a key pressed in between gets its own extra frame right away
+//MODE says which features the level has, the checks of the others are compiled out of the loop
+template<int MODE>
+char game_play(WINDOW* game_window, GameConfig* game_config, Frog* frog, Car *cars, Stork *storks, Renderer *renderer, InputQueue *input, clock_t start_time, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]) {
+#ifdef ALLOC_CHECK
+    int frame = 0;
+    long long warm_count = 0;
+#endif
+    clock_t frame_length = FRAME_TIME * CLOCKS_PER_SEC / 1000;
+    clock_t next_frame = game_clock();
+    RoundEnd end;
+    bool ending = false;
+    for (;;) {
+        if(ending == true){
+            if(step_round_end(&end, frog, input, game_config->scores) == true){
+                return false;
+            }
+            wait_for_input(input, game_clock() + frame_length);
+            continue;
+        }
+#ifdef ALLOC_CHECK
+        check_frame_allocations(frame++, &warm_count);
+#endif
+        clock_t frame_start = game_clock();
+        int time_elapsed = (frame_start - start_time) / CLOCKS_PER_SEC;             //counting past time
+        char update = game_update<MODE>(game_config, frog, cars, storks, input, roads_pos, cars_on_lane, free_lanes, lane_directions);
+        if(update == 'q'){
+            return false;
+        }
+        if(update == 'p'){
+            if(pause_game(game_config, frog, cars, storks, renderer, input, &start_time, time_elapsed) == 'q'){
+                return false;
+            }
+            next_frame = game_clock();
+            continue;
+        }
+        char result = check_game_status<MODE>(game_config, frog, cars, storks);
+        clock_t frame_cost = game_clock() - frame_start;
+        if(metrics != NULL){
+            CarsSample sample;
+            init_cars_sample(&sample);
+            sample_cars(&sample, game_config, cars_on_lane);
+            store_cars(&sample);
+            count_frame((long long)frame_cost * 1000000 / CLOCKS_PER_SEC);
+        }
+        //the last frame of the round is always drawn
+        if(simulation_fits(&renderer->watchdog, frame_cost) || result != 'n'){
+            publish_snapshot(renderer, game_config, frog, cars, storks, time_elapsed, false);
+        }
+        if (result != 'n') { //if game is won or lost, the result screen takes over the loop
+            begin_round_end(&end, game_window, game_config, frog, renderer, result, time_elapsed);
+            clear_cars();
+            ending = true;
+            continue;
+        }
+
+        clock_t now = game_clock();
+        if(now >= next_frame){
+            next_frame += frame_length;
+            if(next_frame <= now){      //too far behind, the missed frames are not made up
+                next_frame = now + frame_length;
+            }
+        }
+        wait_for_input(input, next_frame); // Małe opóźnienie pętli
+    }
+}
+
+typedef char (*GamePlay)(WINDOW*, GameConfig*, Frog*, Car*, Stork*, Renderer*, InputQueue*, clock_t, int[], int[], int*, int[]);
+
+const GamePlay game_plays[GAME_MODES] = {
+    game_play<0>, game_play<1>, game_play<2>, game_play<3>,
+    game_play<4>, game_play<5>, game_play<6>, game_play<7>,
+    game_play<8>, game_play<9>, game_play<10>, game_play<11>,
+    game_play<12>, game_play<13>, game_play<14>, game_play<15>,
+};
+
+//which features are on in the level, decided once when it's loaded
+int game_mode(GameConfig *game_config){
+    int mode = 0;
+    if(game_config->stork_count > 0){
+        mode |= MODE_STORKS;
+    }
+    if(game_config->f_car_chance > 0){
+        mode |= MODE_FRIENDLY_CARS;
+    }
+    if(game_config->n_car_chance > 0){
+        mode |= MODE_NEUTRAL_CARS;
+    }
+    if(game_config->endless == true){
+        mode |= MODE_ENDLESS;
+    }
+    return mode;
+}
+
+//PREPARING TO START THE GAME
+
+bool initialize_game(GameConfig* game_config, Frog* frog) {
+    game_config->car_number = 1;
+    game_config->f_car_chance = 0;
+    game_config->n_car_chance = 0;
+    if (!start_game()) {
+        return false;
+    }
+    return true;
+}
+
+void setup_roads(GameConfig* game_config, int roads_pos[]) {
+    int temp = 0;
+    for (int i = 0; i < game_config->height; i++) {
+        if (any_bits(game_config->board.road[i], 0, 1)) {
+            roads_pos[temp] = i;
+            temp++;
+            i++;
+        }
+    }
+}
+
+int* setup_cars_on_lane(GameConfig* game_config, Arena *arena) {
+    int* cars_on_lane = (int*)arena_alloc(arena, lane_capacity(game_config) * sizeof(int));
+    for (int i = 0; i < lane_capacity(game_config); i++) {
+        cars_on_lane[i] = 0;
+    }
+    return cars_on_lane;
+}
+
+int* setup_lane_directions(GameConfig* game_config, Arena *arena) {
+    int* lane_directions = (int*)arena_alloc(arena, lane_capacity(game_config) * sizeof(int));
+    for (int i = 0; i < game_config->road_lanes; i++) {
+        if(game_rand(game_config) % 2 == 0){
+            lane_directions[i] = 1;
+        }
+        else {
+            lane_directions[i] = -1;
+        }
+    }
+    return lane_directions;
+}
+
+//everything the round has used is in the arena, so there's nothing to free one by one
+void cleanup_game(WINDOW *game_window, Arena *arena) {
+    arena_reset(arena);
+    delwin(game_window);
+    endwin();
+}
+
+//how much of the arena setup_round takes
+size_t round_bytes(GameConfig *game_config){
+    return arena_aligned(MAX_FROGS * sizeof(Frog))
+         + arena_aligned(game_config->car_number * sizeof(Car))
+         + arena_aligned(game_config->stork_count * sizeof(Stork))
+         + pool_bytes(MAX_FROGS) + pool_bytes(game_config->car_number) + pool_bytes(game_config->stork_count)
+         + 2 * arena_aligned(lane_capacity(game_config) * sizeof(int));
+}
+
+//how much of the arena a round with this config takes, with the drawing and the saved state
+size_t session_bytes(GameConfig *game_config){
+    return round_bytes(game_config)
+         + 3 * (arena_aligned(game_config->car_number * sizeof(Car)) + arena_aligned(game_config->stork_count * sizeof(Stork)))     //snapshots for the renderer
+         + (game_config->endless == true ? 3 * arena_aligned(sizeof(BoardPlanes)) : 0)
+         + (game_config->output == OUTPUT_ANSI ? ansi_screen_bytes(game_config) : 0);
+}
+
+//CREATING THE MENU PAGE
+
+void display_menu() {
+    clear();
+    mvprintw(5, 10, "___=== Game Menu ===___");
+    mvprintw(6, 10, "1. Start Game");
+    mvprintw(7, 10, "2. Show Leaderboard");
+    mvprintw(8, 10, "3. Game Rules");
+    mvprintw(9, 10, "4. Exit");
+    mvprintw(11, 10, "Choose an option from 1 to 4:");
+    refresh();
+}
+
+void show_levels() {
+    clear();
+    mvprintw(5, 10, "___=== Select Difficulty ===___");
+    mvprintw(6, 10, "1. Easy level");
+    mvprintw(7, 10, "2. Medium level");
+    mvprintw(8, 10, "3. Difficult level");
+    mvprintw(10, 10, "Choose an option from 1 to 3:");
+    refresh();
+}
+
+bool handle_level_choice(int choice, char config_file_name[]) {
+    switch (choice) {
+        case 1: // Name of the easy level config file
+        case 2: // -=- medium
+        case 3: // -=- difficult
+            strcpy(config_file_name, level_files[choice - 1]);
+            return true;
+        default:
+            return false;
+            refresh();
+            getch();
+    }
+    return false;
+}
+
+void print_game_rules(){
+    clear();
+    mvprintw(5, 10, "___=== Game Rules ===___");
+    mvprintw(6, 10, "1) Move with arrows;");
+    mvprintw(7, 10, "2) Red cars are hostile ones;");
+    mvprintw(8, 10, "3) Yellow cars are neutral, they will wait for you to pass them by;");
+    mvprintw(9, 10, "4) Same with blue cars, but they can also take you to another place");
+    mvprintw(10, 10, "\t4.1) If you want to hop into a car you need to press 'i'");
+    mvprintw(11, 10, "\t\ton your keyboard when you are close to them. Your car turns green.");
+    mvprintw(12, 10, "\t4.2) In order to get out of the car you need to press 'o';");
+    mvprintw(13, 10, "5) If you want to quit the game press 'q'.");
+    mvprintw(14, 10, "6) 'p' pauses the game, press it again to play on.");
+    mvprintw(16, 10, "Press anything to get back to the main menu.");
+    refresh();
+}
+
+//the level couldn't be loaded; the loader only keeps the error, it's shown here where curses is in charge
+void show_config_error(GameConfig *game_config){
+    nodelay(stdscr, FALSE);
+    clear();
+    mvprintw(5, 10, "Somethings wrong with the given data in the config file.");
+    mvprintw(6, 10, "%s", game_config->error);
+    mvprintw(8, 10, "Press anything to get back to the main menu.");
+    refresh();
+    getch();
+}
+
+char handle_menu_choice(int choice, char config_file_name[], ScoreWriter *scores) { 
+    switch (choice) {
+        case 1: {
+            int level_choice;
+            show_levels();
+            level_choice = getch() - '0';
+            if (handle_level_choice(level_choice, config_file_name) == true) {
+                return 's';
+            }
+            break;
+        }
+        case 2:
+            clear();
+            wait_for_scores(scores);
+            show_ranking();
+            refresh();
+            getch();
+            break;
+        case 3:
+            print_game_rules();
+            getch();
+            break;
+        case 4:
+            return 'e';
+        default:
+            mvprintw(12, 10, "Invalid choice, pick a number from 1 to 4.");
+            refresh();
+            getch();
+    }
+    return 'n';
+}
+
+//reads the level from game_config->file_name; loaded_frog gets the frogs settings from it
+bool load_level(GameConfig *game_config, Frog *loaded_frog, int roads_pos[]){
+    loaded_frog->jump_buffer = 0;
+    game_config->car_number = 1;
+    game_config->stork_alive = false;
+    game_config->stork_count = -1;
+    game_config->f_car_chance = 0;      //levels without these keys have only hostile cars
+    game_config->n_car_chance = 0;
+    game_config->endless = false;
+    game_config->map_file[0] = '\0';
+    game_config->map = NULL;
+    game_config->error[0] = '\0';
+
+    if (read_config(game_config, loaded_frog) == false) {
+        return false;
+    }
+    for (int i = 0; i < MAX_NUM; i++) {
+        roads_pos[i] = 0;
+    }
+    setup_roads(game_config, roads_pos);
+    build_nav_table(game_config);
+    return true;
+}
+
+//carves the entities of a round from the arena and puts them on the board
+void setup_round(GameConfig *game_config, Arena *arena, Frog *loaded_frog, int roads_pos[], Frog **frog, Car **cars, Stork **storks, int **cars_on_lane, int *free_lanes, int **lane_directions){
+    event_clock = game_clock();
+    Frog *frogs = (Frog*)arena_alloc(arena, MAX_FROGS * sizeof(Frog));
+    init_pool(&game_config->frog_pool, MAX_FROGS, arena);
+    *frog = &frogs[spawn_entity(&game_config->frog_pool)];
+    **frog = *loaded_frog;
+    game_config->distance = 0;
+
+    *cars_on_lane = setup_cars_on_lane(game_config, arena);
+    *free_lanes = game_config->road_lanes;
+    *lane_directions = setup_lane_directions(game_config, arena);
+
+    *cars = (Car*)arena_alloc(arena, game_config->car_number * sizeof(Car));
+    *storks = (Stork*)arena_alloc(arena, game_config->stork_count * sizeof(Stork));
+    init_pool(&game_config->car_pool, game_config->car_number, arena);
+    init_pool(&game_config->stork_pool, game_config->stork_count, arena);
+    init_frog(game_config, *frog);
+    init_cars(*cars, game_config, roads_pos, *cars_on_lane, free_lanes, *lane_directions);
+    init_storks(game_config, *storks, *frog);
+}
+
+            //LEVEL CACHE - LEVELS PARSED ON A BACKGROUND THREAD, KEYED BY FILE AND MTIME
+int level_index(const char *file_name){
+    for(int i = 0; i < LEVEL_COUNT; i++){
+        if(strcmp(level_files[i], file_name) == 0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool level_modified(const char *file_name, struct timespec *modified){
+    struct stat info;
+    if(stat(file_name, &info) < 0){
+        return false;
+    }
+    *modified = info.st_mtim;
+    return true;
+}
+
+bool same_time(struct timespec a, struct timespec b){
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+//the level part of the config; what main set up (output, frame budget, spectators, scores) stays as it is
+void copy_level(GameConfig *game_config, GameConfig *level){
+    int output = game_config->output;
+    int frame_budget = game_config->frame_budget;
+    SpectatorRing *spectators = game_config->spectators;
+    ScoreWriter *scores = game_config->scores;
+    *game_config = *level;
+    game_config->output = output;
+    game_config->frame_budget = frame_budget;
+    game_config->spectators = spectators;
+    game_config->scores = scores;
+}
+
+void free_level_entry(LevelEntry *entry){
+    if(entry != NULL && entry->has_map == true){
+        free_run_board(&entry->map);
+    }
+    delete entry;
+}
+
+//puts a parsed level into the cache, the entry it replaces is freed unless a round still plays on its map
+void store_level(LevelCache *cache, LevelEntry *entry){
+    int index = level_index(entry->file_name);
+    if(index < 0){
+        entry->replaced = true;         //not one of the menu levels, it only lives as long as a round borrows it
+        if(entry->borrowers == 0){
+            free_level_entry(entry);
+        }
+        return;
+    }
+    LevelEntry *old;
+    {
+        std::lock_guard<std::mutex> lock(cache->entries_mutex);
+        old = cache->entries[index];
+        cache->entries[index] = entry;
+        if(old != NULL && old->borrowers > 0){
+            old->replaced = true;
+            old = NULL;
+        }
+    }
+    free_level_entry(old);
+}
+
+//the round is over, an entry that was replaced meanwhile goes with its last borrower
+void release_level(LevelCache *cache, LevelEntry *entry){
+    bool unused;
+    {
+        std::lock_guard<std::mutex> lock(cache->entries_mutex);
+        entry->borrowers--;
+        unused = entry->borrowers == 0 && entry->replaced == true;
+    }
+    if(unused == true){
+        free_level_entry(entry);
+    }
+}
+
+//true if neither the config nor its map has changed since the entry was parsed
+bool entry_fresh(LevelEntry *entry, struct timespec modified){
+    if(entry == NULL || same_time(entry->modified, modified) == false){
+        return false;
+    }
+    struct timespec map_modified;
+    bool uses_map = entry->level.endless == true && entry->level.map_file[0] != '\0';
+    return uses_map == false || (level_modified(entry->level.map_file, &map_modified) == true && same_time(entry->map_modified, map_modified));
+}
+
+//a file that can't be parsed (or names a map that can't) still gets an entry, without the level but with the error
+//this runs on the loader thread too, so nothing is printed here
+LevelEntry *parse_level(const char *file_name, struct timespec modified){
+    LevelEntry *entry = new LevelEntry();
+    strcpy(entry->file_name, file_name);
+    entry->modified = modified;
+    entry->map_modified = {0, 0};
+    entry->has_map = false;
+    entry->borrowers = 0;
+    entry->replaced = false;
+    strcpy(entry->level.file_name, file_name);
+    entry->valid = load_level(&entry->level, &entry->frog, entry->roads_pos);
+    //a map can be much bigger than the level, so it's parsed here too and never on the way into a round
+    if(entry->valid == true && entry->level.endless == true && entry->level.map_file[0] != '\0'){
+        level_modified(entry->level.map_file, &entry->map_modified);
+        entry->valid = load_map(&entry->level, &entry->map);
+        entry->has_map = entry->valid;
+    }
+    return entry;
+}
+
+void parse_into_cache(LevelCache *cache, const char *file_name, struct timespec modified){
+    store_level(cache, parse_level(file_name, modified));
+}
+
+//the entry if the cache has the file as it is on the disk now, NULL otherwise
+//an entry that isn't valid is borrowed too, but copies nothing into the game config
+//the entry stays borrowed (its map can be read) until release_level
+LevelEntry *borrow_level(LevelCache *cache, const char *file_name, GameConfig *game_config, Frog *frog, int roads_pos[]){
+    int index = level_index(file_name);
+    struct timespec modified;
+    if(index < 0 || level_modified(file_name, &modified) == false){
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(cache->entries_mutex);
+    LevelEntry *entry = cache->entries[index];
+    if(entry_fresh(entry, modified) == false){
+        return NULL;
+    }
+    if(entry->valid == true){
+        copy_level(game_config, &entry->level);
+        *frog = entry->frog;
+        memcpy(roads_pos, entry->roads_pos, sizeof(entry->roads_pos));
+    }
+    entry->borrowers++;
+    return entry;
+}
+
+//every level that is new or has changed since it was parsed is parsed again, all of them at the same time
+void refresh_levels(LevelCache *cache){
+    std::thread parsers[LEVEL_COUNT];
+    for(int i = 0; i < LEVEL_COUNT; i++){
+        struct timespec modified;
+        if(level_modified(level_files[i], &modified) == false){
+            continue;
+        }
+        bool fresh;
+        {
+            std::lock_guard<std::mutex> lock(cache->entries_mutex);
+            fresh = entry_fresh(cache->entries[i], modified);
+        }
+        if(fresh == false){
+            parsers[i] = std::thread(parse_into_cache, cache, level_files[i], modified);
+        }
+    }
+    for(int i = 0; i < LEVEL_COUNT; i++){
+        if(parsers[i].joinable()){
+            parsers[i].join();
+        }
+    }
+}
+
+void load_levels(LevelCache *cache){
+    while(cache->running.load()){
+        {
+            std::unique_lock<std::mutex> lock(cache->wake_mutex);
+            cache->wake.wait(lock, [cache]{
+                return cache->refresh == true || cache->running.load() == false;
+            });
+            cache->refresh = false;
+        }
+        if(cache->running.load()){
+            refresh_levels(cache);
+        }
+    }
+}
+
+//asks the loader to look at the files again, it does while the round plays
+void request_level_refresh(LevelCache *cache){
+    std::lock_guard<std::mutex> lock(cache->wake_mutex);
+    cache->refresh = true;
+    cache->wake.notify_one();
+}
+
+void start_level_cache(LevelCache *cache){
+    for(int i = 0; i < LEVEL_COUNT; i++){
+        cache->entries[i] = NULL;
+    }
+    cache->refresh = true;
+    cache->running.store(true);
+    cache->loader = std::thread(load_levels, cache);
+}
+
+void stop_level_cache(LevelCache *cache){
+    {
+        std::lock_guard<std::mutex> lock(cache->wake_mutex);
+        cache->running.store(false);
+        cache->wake.notify_one();
+    }
+    cache->loader.join();
+    for(int i = 0; i < LEVEL_COUNT; i++){
+        free_level_entry(cache->entries[i]);
+    }
+}
+
+int play(GameConfig *game_config, Arena *arena, LevelCache *cache) {
+    Frog loaded_frog;       //the config file sets the frogs jump delay
+    int roads_pos[MAX_NUM];
+    LevelEntry *entry = borrow_level(cache, game_config->file_name, game_config, &loaded_frog, roads_pos);
+    if (entry == NULL) {
+        //not parsed yet (or changed since), so it's parsed here and kept for the next time
+        struct timespec modified = {0, 0};
+        level_modified(game_config->file_name, &modified);
+        entry = parse_level(game_config->file_name, modified);
+        if (entry->valid == true) {
+            copy_level(game_config, &entry->level);
+            loaded_frog = entry->frog;
+            memcpy(roads_pos, entry->roads_pos, sizeof(entry->roads_pos));
+        }
+        entry->borrowers = 1;
+        store_level(cache, entry);
+    }
+    if (entry->valid == false) {
+        //main shows the error, it owns the terminal
+        strcpy(game_config->error, entry->level.error);
+        release_level(cache, entry);
+        return 0;
+    }
+    game_config->rng = rand();
+    request_level_refresh(cache);
+    game_config->map = entry->has_map == true ? &entry->map : NULL;        //only read during the round
+
+    arena_reset(arena);
+    arena_reserve(arena, session_bytes(game_config));
+
+    Frog *frog;
+    Car *cars;
+    Stork *storks;
+    int *cars_on_lane, *lane_directions;
+    int free_lanes;
+    setup_round(game_config, arena, &loaded_frog, roads_pos, &frog, &cars, &storks, &cars_on_lane, &free_lanes, &lane_directions);
+
+    clock_t start_time = game_clock(); //Time of the beginning of the game
+    WINDOW* game_window = newwin(game_config->height + 2, game_config->width + 2, 0, 0); 
+    InputQueue input;
+    start_input(&input);
+    Renderer renderer;
+    init_renderer(&renderer, game_window, game_config, arena);
+    start_renderer(&renderer);
+
+    GamePlay game_play_mode = game_plays[game_mode(game_config)];
+    if (game_play_mode(game_window, game_config, frog, cars, storks, &renderer, &input, start_time, roads_pos, cars_on_lane, &free_lanes, lane_directions) == false) {
+        stop_renderer(&renderer);
+        stop_input(&input);
+        cleanup_game(game_window, arena);    
+    }
+    clear_cars();           //a round left with q doesn't get to its end screen
+    game_config->map = NULL;
+    release_level(cache, entry);
+    return 1;
+}
+
+//BENCHMARK OF SAVING AND RESTORING THE GAME STATE (--bench-state [cars]), runs without the terminal
+double microseconds_since(std::chrono::steady_clock::time_point start, int rounds){
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+//the frames of the rollback check: the clock goes on by FRAME_TIME, the frog jumps every fourth frame
+void play_bench_frames(GameConfig *game_config, Frog *frog, Car *cars, Stork *storks, clock_t *now, int frames, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
+    for(int frame = 0; frame < frames; frame++){
+        *now += FRAME_TIME * CLOCKS_PER_SEC / 1000;
+        if(frame % 4 == 0){
+            frogs_move(game_config, frog, frame % 8 == 0 ? KEY_UP : KEY_LEFT, *now);
+        }
+        cars_move<MODE_STORKS | MODE_FRIENDLY_CARS | MODE_NEUTRAL_CARS>(game_config, cars, frog, roads_pos, cars_on_lane, free_lanes, lane_directions);
+        move_storks(game_config, storks, frog);
+    }
+}
+
+//two saved states are the same game if everything but the time they were saved at matches
+bool same_game_state(const char *first, const char *second, size_t bytes){
+    StateHeader first_header, second_header;
+    memcpy(&first_header, first, sizeof(StateHeader));
+    memcpy(&second_header, second, sizeof(StateHeader));
+    first_header.saved_at = 0;
+    second_header.saved_at = 0;
+    return memcmp(&first_header, &second_header, sizeof(StateHeader)) == 0
+        && memcmp(first + sizeof(StateHeader), second + sizeof(StateHeader), bytes - sizeof(StateHeader)) == 0;
+}
+
+int bench_state(int car_number){
+    GameConfig *game_config = new GameConfig();
+    game_config->width = MAX_NUM;
+    game_config->height = MAX_NUM;
+    game_config->road_lanes = MAX_NUM / 2;
+    game_config->min_car_delay = 40;
+    game_config->max_car_delay = 100;
+    game_config->f_car_chance = 30;
+    game_config->n_car_chance = 20;
+    game_config->car_number = car_number;
+    game_config->stork_count = 5;
+    game_config->rng = 1;
+    for(int i = 0; i < game_config->height; i++){
+        for(int j = 0; j < game_config->width; j++){
+            set_board_field(game_config, i, j, 'R');
+        }
+    }
+    int roads_pos[MAX_NUM] = {0};
+    setup_roads(game_config, roads_pos);
+    build_nav_table(game_config);
+
+    Arena arena;
+    init_arena(&arena, ARENA_START_SIZE);
+    arena_reserve(&arena, session_bytes(game_config) + 3 * arena_aligned(game_state_bytes(game_config)));
+    Frog bench_frog;
+    bench_frog.jump_delay = 400;
+    bench_frog.jump_buffer = 0;
+    Frog *frog;
+    Car *cars;
+    Stork *storks;
+    int *cars_on_lane, *lane_directions;
+    int free_lanes;
+    setup_round(game_config, &arena, &bench_frog, roads_pos, &frog, &cars, &storks, &cars_on_lane, &free_lanes, &lane_directions);
+
+    size_t bytes = game_state_bytes(game_config);
+    char *state = (char*)arena_alloc(&arena, bytes);
+    char *played = (char*)arena_alloc(&arena, bytes);
+    char *replayed = (char*)arena_alloc(&arena, bytes);
+    clock_t start_time = game_clock();
+    const int rounds = 1000;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++){
+        save_game_state(state, game_config, frog, cars, storks, start_time, roads_pos, cars_on_lane, free_lanes, lane_directions);
+    }
+    double save_time = microseconds_since(start, rounds);
+
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++){
+        restore_game_state(state, game_config, frog, cars, storks, &start_time, roads_pos, cars_on_lane, &free_lanes, lane_directions, false);
+    }
+    double restore_time = microseconds_since(start, rounds);
+
+    //rollback: the frames after a save are played, rolled back and played again with the same clock and keys,
+    //both runs have to end in the same state byte for byte
+    const int frames = 50;
+    clock_t now = game_clock();
+    clock_t saved_now = now;
+    simulated_clock = &now;
+    save_game_state(state, game_config, frog, cars, storks, start_time, roads_pos, cars_on_lane, free_lanes, lane_directions);
+    play_bench_frames(game_config, frog, cars, storks, &now, frames, roads_pos, cars_on_lane, &free_lanes, lane_directions);
+    save_game_state(played, game_config, frog, cars, storks, start_time, roads_pos, cars_on_lane, free_lanes, lane_directions);
+    restore_game_state(state, game_config, frog, cars, storks, &start_time, roads_pos, cars_on_lane, &free_lanes, lane_directions, false);
+    now = saved_now;
+    play_bench_frames(game_config, frog, cars, storks, &now, frames, roads_pos, cars_on_lane, &free_lanes, lane_directions);
+    save_game_state(replayed, game_config, frog, cars, storks, start_time, roads_pos, cars_on_lane, free_lanes, lane_directions);
+    simulated_clock = NULL;
+    bool same = same_game_state(played, replayed, bytes);
+    bool moved = same_game_state(state, played, bytes) == false;     //the frames must have changed something, or the check says nothing
+
+    printf("cars: %d, state: %zu bytes\n", car_number, bytes);
+    printf("save: %.1f us, restore: %.1f us\n", save_time, restore_time);
+    printf("replay of %d frames after a rollback: %s\n", frames, same ? "identical" : "DIFFERENT");
+    if(moved == false){
+        printf("the frames didn't change the state\n");
+    }
+
+    free_arena(&arena);
+    delete game_config;
+    return same && moved ? 0 : 1;
+}
+
+//SELF-CHECK OF THE SWEPT COLLISIONS (--check-collisions), runs without the terminal, exits with 1 if a case fails
+bool check_case(const char *name, bool result, bool expected){
+    printf("%-55s %s\n", name, result == expected ? "ok" : "FAILED");
+    return result == expected;
+}
+
+void place_stork(Stork *stork, int x0, int y0, int x1, int y1){
+    stork->alive = true;
+    stork->prev_x = x0;
+    stork->prev_y = y0;
+    stork->x = x1;
+    stork->y = y1;
+}
+
+int check_collisions(){
+    bool ok = true;
+    Frog frog = {};
+    Stork stork = {};
+    frog.frogs_car = no_handle();
+
+    //the frog jumps two rows up, the stork sits in the row it jumps over
+    frog.prev_x = 10;
+    frog.prev_y = 10;
+    frog.x = 10;
+    frog.y = 8;
+    place_stork(&stork, 10, 9, 10, 9);
+    ok &= check_case("stork in the row the frog jumps over", check_stork_collision(&frog, &stork), true);
+    place_stork(&stork, 14, 9, 14, 9);
+    ok &= check_case("stork next to the jump", check_stork_collision(&frog, &stork), false);
+    //the stork flies through the frog between two frames
+    frog.prev_x = frog.x;
+    frog.prev_y = frog.y;
+    place_stork(&stork, 8, 8, 12, 8);
+    ok &= check_case("stork flying through a standing frog", check_stork_collision(&frog, &stork), true);
+
+    //a friendly car picks the frog up, the stork stands on the line from the frog to the place of a carried frog
+    GameConfig *game_config = new GameConfig();
+    game_config->width = 40;
+    game_config->height = 21;
+    Arena arena;
+    init_arena(&arena, ARENA_START_SIZE);
+    init_pool(&game_config->car_pool, 1, &arena);
+    Car car = {};
+    spawn_entity(&game_config->car_pool);
+    frog.x = frog.prev_x = 4;
+    frog.y = frog.prev_y = 15;
+    frog_gets_in_the_car(game_config, &frog, &car, &car);
+    place_stork(&stork, 12, 18, 12, 18);
+    ok &= check_case("stork on the way of a frog picked up by a car", check_stork_collision(&frog, &stork), false);
+    place_stork(&stork, frog.x, frog.y, frog.x, frog.y);
+    ok &= check_case("stork on a carried frog", check_stork_collision(&frog, &stork), false);
+
+    free_arena(&arena);
+    delete game_config;
+    return ok == true ? 0 : 1;
+}
+
+//BENCHMARK OF THE RUN BOARD (--bench-board [width height]), a generated map far bigger than any level
+void generate_map_rows(GameConfig *game_config, RunBoard *board, int height){
+    char *line = new char[board->width + 1];
+    line[board->width] = '\0';
+    while(board->height < height){
+        bool road = game_rand(game_config) % 100 < ENDLESS_ROAD_CHANCE;
+        int rows = road ? 2 : 2 + 2 * (game_rand(game_config) % 4);        //grass is 2 to 8 rows
+        for(int r = 0; r < rows && board->height < height; r++){
+            memset(line, road ? 'R' : 'G', board->width);
+            if(road == false && game_rand(game_config) % 100 < ENDLESS_OBSTACLE_CHANCE){
+                int obstacles = game_rand(game_config) % 4 + 1;
+                for(int i = 0; i < obstacles; i++){
+                    int length = game_rand(game_config) % 6 + 2;
+                    memset(line + game_rand(game_config) % (board->width - length + 1), 'O', length);
+                }
+            }
+            append_run_row(board, line);
+        }
+    }
+    delete[] line;
+}
+
+int bench_random(GameConfig *game_config, int limit){
+    return ((game_rand(game_config) << 15) | game_rand(game_config)) % limit;
+}
+
+int bench_board(int width, int height){
+    if(width < 8 || width > RUN_BOARD_MAX_WIDTH || height < 1){
+        std::cerr << "The map has to be 8 to " << RUN_BOARD_MAX_WIDTH << " fields wide.\n";
+        return 1;
+    }
+    GameConfig *game_config = new GameConfig();
+    game_config->rng = 1;
+    RunBoard board;
+    init_run_board(&board, width);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    generate_map_rows(game_config, &board, height);
+    trim_run_board(&board);
+    double build_time = microseconds_since(start, 1000);
+
+    int *rows = new int[BENCH_LOOKUPS];
+    int *columns = new int[BENCH_LOOKUPS];
+    for(int i = 0; i < BENCH_LOOKUPS; i++){
+        rows[i] = bench_random(game_config, height);
+        columns[i] = bench_random(game_config, width);
+    }
+    long long checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < BENCH_LOOKUPS; i++){
+        checksum += run_field(&board, rows[i], columns[i]);
+    }
+    double lookup_time = microseconds_since(start, BENCH_LOOKUPS) * 1000;
+
+    //every row walked run by run, the lengths have to add up to the whole map
+    long long cells = 0;
+    start = std::chrono::steady_clock::now();
+    for(int row = 0; row < height; row++){
+        int first, end;
+        row_runs(&board, row, &first, &end);
+        for(int i = first; i < end; i++){
+            cells += run_length(&board, i, end);
+        }
+    }
+    double walk_time = microseconds_since(start, 1000);
+
+    bool same = cells == (long long)width * height;
+    for(int i = 0; i < 100 && same; i++){
+        int row = bench_random(game_config, height);
+        int first, end;
+        row_runs(&board, row, &first, &end);
+        for(int run = first; run < end; run++){
+            for(int column = board.runs[run].start; column < board.runs[run].start + run_length(&board, run, end); column++){
+                if(run_field(&board, row, column) != board.runs[run].field){
+                    same = false;
+                }
+            }
+        }
+    }
+
+    printf("map: %d x %d = %lld cells\n", width, height, (long long)width * height);
+    printf("runs: %d, spans: %d, memory: %zu bytes (dense: %lld bytes)\n", board.run_count, board.span_count, run_board_bytes(&board), (long long)width * height);
+    printf("build: %.1f ms, lookup: %.1f ns, walking all runs: %.1f ms (checksum %lld)\n", build_time, lookup_time, walk_time, checksum);
+    printf("lookups and runs: %s\n", same ? "agree" : "DIFFERENT");
+
+    delete[] rows;
+    delete[] columns;
+    free_run_board(&board);
+    delete game_config;
+    return same ? 0 : 1;
+}
+
+
+//DIFFICULTY TUNER (--tune CONFIG WIN% MEDIAN_SECONDS [OUTPUT]), plays the level headless with a simple player
+            //THE PLAYER - JUMPS CLOSER TO THE TOP WHEN THE LANDING CELL STAYS FREE FOR A WHILE, GETS OUT OF THE WAY OTHERWISE
+//the car comes into the cell within ms milliseconds (if it just keeps going)
+bool car_reaches_cell(Car *car, int x, int y, int ms){
+    if(y < car->y || y > car->y + CAR_HEIGHT - 1){
+        return false;
+    }
+    int reach = ms / car->delay + 1;
+    int low = car->x, high = car->x + CAR_WIDTH - 1;
+    if(car->direction == 1){
+        high += reach;
+    }
+    else{
+        low -= reach;
+    }
+    return x + 1 >= low - 1 && x <= high + 1;
+}
+
+//index is NULL when there's one frog, then all the cars are just checked
+bool is_cell_safe(GameConfig *game_config, Car *cars, CarIndex *index, int x, int y, int ms){
+    if(index == NULL){
+        for(int i = 0; i < game_config->car_pool.count; i++){
+            if(car_reaches_cell(&cars[i], x, y, ms)){
+                return false;
+            }
+        }
+        return true;
+    }
+    int reach = ms / (game_config->min_car_delay > 0 ? game_config->min_car_delay : 1) + 1;     //no car is faster than that
+    for(int row = y - CAR_HEIGHT + 1; row <= y; row++){
+        int begin, end;
+        indexed_cars(index, row, x - CAR_WIDTH - reach, x + 2 + reach, &begin, &end);
+        for(int i = begin; i < end; i++){
+            if(car_reaches_cell(&cars[index->order[i]], x, y, ms)){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//jumps from every cell of the frog to the top row, along the nav table and around the obstacles (cars don't count)
+void build_goal_distance(GameConfig *game_config, unsigned short distance[][MAX_NUM + 2]){
+    const char moves[4] = {'U', 'D', 'R', 'L'};
+    for(int y = 0; y < MAX_NUM + 2; y++){
+        for(int x = 0; x < MAX_NUM + 2; x++){
+            distance[y][x] = y == 1 ? 0 : FLOW_UNREACHABLE;
+        }
+    }
+    //the board is small, so the distances are just improved until nothing changes
+    bool changed = true;
+    while(changed == true){
+        changed = false;
+        for(int y = 2; y <= game_config->height; y++){
+            for(int x = 1; x <= game_config->width; x++){
+                for(int i = 0; i < 4; i++){
+                    int target_x, target_y;
+                    nav_target(game_config, x, y, moves[i], &target_x, &target_y);
+                    if(distance[target_y][target_x] != FLOW_UNREACHABLE && distance[target_y][target_x] + 1 < distance[y][x]){
+                        distance[y][x] = distance[target_y][target_x] + 1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int direction_key(char direction){
+    if(direction == 'U') return KEY_UP;
+    if(direction == 'D') return KEY_DOWN;
+    if(direction == 'R') return KEY_RIGHT;
+    return KEY_LEFT;
+}
+
+//the key the player presses in this frame, ERR if it waits
+int player_key(GameConfig *game_config, Frog *frog, Car *cars, CarIndex *index, clock_t now, unsigned short goal_distance[][MAX_NUM + 2]){
+    if(can_frog_jump(game_config, frog, now) == false){
+        return ERR;
+    }
+    int horizon = frog->jump_delay + 2 * FRAME_TIME;        //until it can jump again from where it lands
+    bool is_safe_here = is_cell_safe(game_config, cars, index, frog->x, frog->y, horizon);
+    const char moves[4] = {'U', 'L', 'R', 'D'};
+    int best = goal_distance[frog->y][frog->x];
+    int key = ERR, escape = ERR;
+    for(int i = 0; i < 4; i++){
+        int x, y;
+        nav_target(game_config, frog->x, frog->y, moves[i], &x, &y);
+        if((x == frog->x && y == frog->y) || is_cell_safe(game_config, cars, index, x, y, horizon) == false){
+            continue;
+        }
+        if(goal_distance[y][x] < best){
+            best = goal_distance[y][x];
+            key = direction_key(moves[i]);
+        }
+        else if(escape == ERR){
+            escape = direction_key(moves[i]);
+        }
+    }
+    //a jump that gets closer to the other side, or any jump away from a car that's coming
+    if(key != ERR){
+        return key;
+    }
+    return is_safe_here ? ERR : escape;
+}
+
+            //HEADLESS GAMES
+//the same steps as game_update, with the player instead of the keyboard and a clock that jumps a frame at a time
+template<int MODE>
+char simulate_game(GameConfig *game_config, Frog *frog, Car *cars, Stork *storks, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[], unsigned short goal_distance[][MAX_NUM + 2], clock_t *now, clock_t until){
+    clock_t frame_length = FRAME_TIME * CLOCKS_PER_SEC / 1000;
+    while(*now < until){
+        *now += frame_length;
+        frog->prev_x = frog->x;
+        frog->prev_y = frog->y;
+        int key = player_key(game_config, frog, cars, NULL, *now, goal_distance);
+        if(key != ERR){
+            apply_key<MODE>(game_config, frog, cars, key, *now);
+        }
+        game_step<MODE>(game_config, frog, cars, storks, roads_pos, cars_on_lane, free_lanes, lane_directions);
+        char result = round_result<MODE>(game_config, frog, cars, storks);
+        if(result != 'n'){
+            return result;
+        }
+    }
+    return 't';
+}
+
+typedef char (*SimulateGame)(GameConfig*, Frog*, Car*, Stork*, int[], int[], int*, int[], unsigned short[][MAX_NUM + 2], clock_t*, clock_t);
+
+//endless levels can't be won, so they can't be tuned
+const SimulateGame simulate_games[GAME_MODES] = {
+    simulate_game<0>, simulate_game<1>, simulate_game<2>, simulate_game<3>,
+    simulate_game<4>, simulate_game<5>, simulate_game<6>, simulate_game<7>,
+};
+
+void apply_params(GameConfig *game_config, Frog *frog, TuneParams *params){
+    game_config->car_number = params->car_number;
+    game_config->min_car_delay = params->min_car_delay;
+    game_config->max_car_delay = params->max_car_delay;
+    game_config->f_car_chance = params->f_car_chance;
+    game_config->n_car_chance = params->n_car_chance;
+    frog->jump_delay = params->jump_delay;
+}
+
+void play_tune_game(Tuner *tuner, TuneGame *game, GameConfig *game_config, Arena *arena, clock_t *now){
+    *game_config = *tuner->level;
+    Frog loaded_frog = tuner->level_frog;
+    apply_params(game_config, &loaded_frog, &tuner->candidates[game->candidate].params);
+    game_config->rng = game->seed;
+    int roads_pos[MAX_NUM];
+    memcpy(roads_pos, tuner->roads_pos, sizeof(roads_pos));
+
+    arena_reset(arena);
+    arena_reserve(arena, round_bytes(game_config));
+    *now = CLOCKS_PER_SEC;      //every game starts at the same time, so a seed always plays the same game on any thread
+    Frog *frog;
+    Car *cars;
+    Stork *storks;
+    int *cars_on_lane, *lane_directions;
+    int free_lanes;
+    setup_round(game_config, arena, &loaded_frog, roads_pos, &frog, &cars, &storks, &cars_on_lane, &free_lanes, &lane_directions);
+
+    clock_t start = *now;
+    clock_t until = start + (clock_t)tuner->time_limit * CLOCKS_PER_SEC / 1000;
+    game->result = simulate_games[game_mode(game_config)](game_config, frog, cars, storks, roads_pos, cars_on_lane, &free_lanes, lane_directions, tuner->goal_distance, now, until);
+    game->time = (*now - start) * 1000 / CLOCKS_PER_SEC;
+}
+
+//every worker takes the next game that nobody plays yet
+void tune_worker(Tuner *tuner){
+    GameConfig *game_config = new GameConfig();
+    Arena arena;
+    init_arena(&arena, ARENA_START_SIZE);
+    clock_t now;
+    simulated_clock = &now;
+    for(;;){
+        int i = tuner->next_game.fetch_add(1);
+        if(i >= tuner->game_count){
+            break;
+        }
+        play_tune_game(tuner, &tuner->games[i], game_config, &arena, &now);
+    }
+    simulated_clock = NULL;
+    free_arena(&arena);
+    delete game_config;
+}
+
+            //SEARCH - SUCCESSIVE HALVING: MANY CANDIDATES PLAY A FEW GAMES, THE BETTER HALF PLAYS TWICE AS MANY
+int compare_times(const void *a, const void *b){
+    return *(const int*)a - *(const int*)b;
+}
+
+int compare_candidates(const void *a, const void *b){
+    double difference = ((const TuneCandidate*)a)->loss - ((const TuneCandidate*)b)->loss;
+    return difference < 0 ? -1 : (difference > 0 ? 1 : 0);
+}
+
+//ms, the time limit if no game was won
+int median_time(Tuner *tuner, TuneCandidate *candidate){
+    if(candidate->wins == 0){
+        return tuner->time_limit;
+    }
+    qsort(candidate->win_times, candidate->wins, sizeof(int), compare_times);
+    return candidate->win_times[candidate->wins / 2];
+}
+
+double candidate_loss(Tuner *tuner, TuneCandidate *candidate){
+    double win_miss = (double)candidate->wins / candidate->games - tuner->target_win_rate;
+    double time_miss = (double)(median_time(tuner, candidate) - tuner->target_median) / tuner->target_median;
+    return (win_miss < 0 ? -win_miss : win_miss) / TUNE_WIN_TOLERANCE + (time_miss < 0 ? -time_miss : time_miss) / TUNE_TIME_TOLERANCE;
+}
+
+//all the candidates play the same seeds, so they are compared on the same traffic
+void play_candidates(Tuner *tuner, int count, int games, int workers){
+    tuner->game_count = count * games;
+    tuner->games = new TuneGame[tuner->game_count];
+    for(int c = 0; c < count; c++){
+        for(int g = 0; g < games; g++){
+            tuner->games[c * games + g].candidate = c;
+            tuner->games[c * games + g].seed = tuner->candidates[c].games + g + 1;
+        }
+    }
+    tuner->next_game.store(0);
+    std::thread *threads = new std::thread[workers];
+    for(int i = 0; i < workers; i++){
+        threads[i] = std::thread(tune_worker, tuner);
+    }
+    for(int i = 0; i < workers; i++){
+        threads[i].join();
+    }
+    delete[] threads;
+
+    for(int i = 0; i < tuner->game_count; i++){
+        TuneCandidate *candidate = &tuner->candidates[tuner->games[i].candidate];
+        candidate->games++;
+        if(tuner->games[i].result == 'w' && candidate->wins < TUNE_MAX_GAMES){
+            candidate->win_times[candidate->wins++] = tuner->games[i].time;
+        }
+    }
+    delete[] tuner->games;
+    for(int c = 0; c < count; c++){
+        tuner->candidates[c].loss = candidate_loss(tuner, &tuner->candidates[c]);
+    }
+}
+
+//the best candidate ends up first
+void successive_halving(Tuner *tuner, int count, int workers, const char *stage){
+    int games = TUNE_FIRST_GAMES;
+    for(int round = 1; ; round++){
+        play_candidates(tuner, count, games, workers);
+        qsort(tuner->candidates, count, sizeof(TuneCandidate), compare_candidates);
+        TuneCandidate *best = &tuner->candidates[0];
+        printf("%s, round %d: %d candidates x %d games, best: %.0f%% won, median %.1fs (loss %.2f)\n", stage, round, count, games,
+               100.0 * best->wins / best->games, median_time(tuner, best) / 1000.0, best->loss);
+        fflush(stdout);
+
+        //no need to go on once the games are sure enough that the best candidate hits both targets
+        if(count == 1 || (best->games >= TUNE_SURE_GAMES && best->loss < 1)){
+            return;
+        }
+        count = (count + 1) / 2;
+        games = games * 2 < TUNE_ROUND_GAMES ? games * 2 : TUNE_ROUND_GAMES;
+    }
+}
+
+int random_between(int low, int high){
+    return low + rand() % (high - low + 1);
+}
+
+//keeps the settings playable: cars need a delay range and the chances of special cars can't go over 100%
+void clamp_params(TuneParams *params){
+    if(params->car_number < 1) params->car_number = 1;
+    if(params->min_car_delay < 10) params->min_car_delay = 10;
+    if(params->max_car_delay <= params->min_car_delay) params->max_car_delay = params->min_car_delay + 1;
+    if(params->f_car_chance < 0) params->f_car_chance = 0;
+    if(params->n_car_chance < 0) params->n_car_chance = 0;
+    if(params->f_car_chance + params->n_car_chance > 100) params->n_car_chance = 100 - params->f_car_chance;
+    if(params->jump_delay < 50) params->jump_delay = 50;
+}
+
+void random_params(GameConfig *level, TuneParams *params){
+    params->car_number = random_between(1, 6 * (level->road_lanes > 0 ? level->road_lanes : 1));
+    params->min_car_delay = random_between(20, 200);
+    params->max_car_delay = params->min_car_delay + random_between(10, 300);
+    params->f_car_chance = random_between(0, 40);
+    params->n_car_chance = random_between(0, 40);
+    params->jump_delay = random_between(150, 600);
+    clamp_params(params);
+}
+
+//every setting moved by up to a fifth
+void neighbour_params(TuneParams *from, TuneParams *params){
+    *params = *from;
+    params->car_number += random_between(-(params->car_number / 5 + 1), params->car_number / 5 + 1);
+    params->min_car_delay += random_between(-(params->min_car_delay / 5), params->min_car_delay / 5);
+    params->max_car_delay += random_between(-(params->max_car_delay / 5), params->max_car_delay / 5);
+    params->f_car_chance += random_between(-5, 5);
+    params->n_car_chance += random_between(-5, 5);
+    params->jump_delay += random_between(-(params->jump_delay / 5), params->jump_delay / 5);
+    clamp_params(params);
+}
+
+void reset_candidate(TuneCandidate *candidate){
+    candidate->games = 0;
+    candidate->wins = 0;
+    candidate->loss = 0;
+}
+
+//the config file with the tuned lines put in front of the seed, everything else as it was
+bool write_tuned_config(const char *config_file, const char *output, TuneParams *params){
+    const char *keys[] = {"jump_delay=", "car_number=", "min_car_delay=", "max_car_delay=", "n_car_chance=", "f_car_chance="};
+    FILE *in = fopen(config_file, "r");
+    if(!in){
+        return false;
+    }
+    FILE *out = fopen(output, "w");
+    if(!out){
+        fclose(in);
+        return false;
+    }
+    char buffer[MAX_LINE_LENGTH];
+    bool is_seed_found = false;
+    while(fgets(buffer, MAX_LINE_LENGTH, in)){
+        bool is_tuned = false;
+        for(int i = 0; i < 6 && is_seed_found == false; i++){
+            if(strncmp(buffer, keys[i], strlen(keys[i])) == 0){
+                is_tuned = true;
             }
         }
-        frog->direction = 'U';
-        frog->last_jump_time = clock();
+        if(is_seed_found == false && strncmp(buffer, "seed=", 5) == 0){
+            is_seed_found = true;
+            fprintf(out, "jump_delay=%d\ncar_number=%d\nmin_car_delay=%d\nmax_car_delay=%d\n",
+                    params->jump_delay, params->car_number, params->min_car_delay, params->max_car_delay);
+            //parse_basic_data reads n_car_chance= into f_car_chance and the other way round, so they're written the same way
+            fprintf(out, "n_car_chance=%d\nf_car_chance=%d\n", params->f_car_chance, params->n_car_chance);
+        }
+        if(is_tuned == false){
+            fputs(buffer, out);
+        }
+    }
+    fclose(in);
+    fclose(out);
+    return true;
+}
+
+int run_tuner(const char *config_file, double win_percent, double median_seconds, const char *output){
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Tuner *tuner = new Tuner;
+    tuner->level = new GameConfig();
+    if(strlen(config_file) >= sizeof(tuner->level->file_name) || win_percent < 0 || win_percent > 100 || median_seconds <= 0){
+        std::cerr << "Usage: --tune CONFIG WIN_PERCENT MEDIAN_SECONDS [OUTPUT]\n";
+        return 1;
+    }
+    strcpy(tuner->level->file_name, config_file);
+    if(load_level(tuner->level, &tuner->level_frog, tuner->roads_pos) == false){
+        std::cerr << "Somethings wrong with the given data in the config file.\n" << tuner->level->error << "\n";
+        return 1;
+    }
+    if(tuner->level->endless == true){
+        std::cerr << "Endless levels can't be won, so they can't be tuned.\n";
+        return 1;
+    }
+    build_goal_distance(tuner->level, tuner->goal_distance);
+    tuner->target_win_rate = win_percent / 100;
+    tuner->target_median = (int)(median_seconds * 1000);
+    tuner->time_limit = 3 * tuner->target_median;
+    int workers = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    srand(1);       //the same search every time for the same level and targets
+
+    tuner->candidates = new TuneCandidate[TUNE_CANDIDATES];
+    for(int i = 0; i < TUNE_CANDIDATES; i++){
+        tuner->candidates[i].win_times = new int[TUNE_MAX_GAMES];
+        reset_candidate(&tuner->candidates[i]);
+        random_params(tuner->level, &tuner->candidates[i].params);
+    }
+    //the level as it is takes part too
+    TuneParams *current = &tuner->candidates[0].params;
+    current->car_number = tuner->level->car_number;
+    current->min_car_delay = tuner->level->min_car_delay;
+    current->max_car_delay = tuner->level->max_car_delay;
+    current->f_car_chance = tuner->level->f_car_chance;
+    current->n_car_chance = tuner->level->n_car_chance;
+    current->jump_delay = tuner->level_frog.jump_delay;
+    clamp_params(current);
+
+    successive_halving(tuner, TUNE_CANDIDATES, workers, "search");
+
+    //then small changes of the winner, which plays again from scratch with them
+    TuneParams best = tuner->candidates[0].params;
+    double best_loss = tuner->candidates[0].loss;
+    double best_win_rate = (double)tuner->candidates[0].wins / tuner->candidates[0].games;
+    int best_median = median_time(tuner, &tuner->candidates[0]);
+    int best_games = tuner->candidates[0].games;
+    for(int i = 0; i <= TUNE_NEIGHBOURS; i++){
+        reset_candidate(&tuner->candidates[i]);
+        if(i == 0){
+            tuner->candidates[i].params = best;
+        }
+        else{
+            neighbour_params(&best, &tuner->candidates[i].params);
+        }
+    }
+    successive_halving(tuner, TUNE_NEIGHBOURS + 1, workers, "refine");
+
+    //none of the changes may have been better, then the winner of the search stays
+    TuneCandidate *winner = &tuner->candidates[0];
+    if(winner->loss <= best_loss){
+        best = winner->params;
+        best_win_rate = (double)winner->wins / winner->games;
+        best_median = median_time(tuner, winner);
+        best_games = winner->games;
+    }
+    TuneParams *params = &best;
+    char default_output[sizeof(tuner->level->file_name) + 8];
+    if(output == NULL){
+        snprintf(default_output, sizeof(default_output), "%s.tuned", config_file);
+        output = default_output;
+    }
+    bool written = write_tuned_config(config_file, output, params);
+    printf("car_number=%d min_car_delay=%d max_car_delay=%d f_car_chance=%d n_car_chance=%d jump_delay=%d\n",
+           params->car_number, params->min_car_delay, params->max_car_delay, params->f_car_chance, params->n_car_chance, params->jump_delay);
+    printf("%.0f%% won, median %.1fs over %d games, %.1fs of searching\n", 100 * best_win_rate, best_median / 1000.0, best_games, microseconds_since(start, 1000000));
+    if(written == false){
+        std::cerr << "Couldn't write " << output << ".\n";
+    }
+    else{
+        printf("written to %s\n", output);
+    }
+
+    for(int i = 0; i < TUNE_CANDIDATES; i++){
+        delete[] tuner->candidates[i].win_times;
+    }
+    delete[] tuner->candidates;
+    delete tuner->level;
+    delete tuner;
+    return written ? 0 : 1;
 }
 
-void frog_move_down(GameConfig* game_config, Frog *frog){
-    if (frog->y < game_config->height) {
-            if(game_config->board[frog->y - 1 + 1][frog->x] != 'O' && game_config->board[frog->y - 1 + 1][frog->x - 1] != 'O'){      //checking if frog doesnt want to jump onto an obstacle
-                frog->y++;
-                frog->moves++;
-            }
-        }
-        frog->direction = 'D';
-        frog->last_jump_time = clock();
-}
 
-void frog_move_right(GameConfig *game_config, Frog* frog){
-    if (frog->x < game_config->width - 2) {
-            if(game_config->board[frog->y - 1][frog->x + 2] != 'O' && game_config->board[frog->y - 1][frog->x + 1] != 'O'){         //checking if frog doesnt want to jump onto an obstacle
-                frog->x += 2;
-                frog->moves++;
-            } 
-            else if(game_config->board[frog->y - 1][frog->x + 1] != 'O'){                           //if obstacle is half a normal movement in x-axis away then take a smaller jump
-                frog->x += 1;
-                frog->moves++;
-            }
-        }
-        else if(frog->x < game_config->width - 1){                                                  //if game border is half a normal movement in x-axis away then do a smaller jump
-            if(game_config->board[frog->y - 1][frog->x + 1] != 'O'){
-                frog->x += 1;
-                frog->moves++;
-            }
+//CROWD MODE (--crowd CONFIG FROGS [SECONDS] [BROADCAST_NAME]), many frogs of the tuners player on one board, runs without the terminal
+            //THE FROGS - ONE DENSE ARRAY, A FROG THAT WINS OR DIES STARTS AGAIN AT THE BOTTOM
+void place_crowd_frog(GameConfig *game_config, Frog *frog, clock_t now){
+    int x = game_config->width / 2 + 1;
+    for(int attempt = 0; attempt < 8; attempt++){
+        int candidate = game_rand(game_config) % (game_config->width - 1) + 1;
+        if(is_obstacle(game_config, game_config->height, candidate, 2) == false){
+            x = candidate;
+            break;
         }
-        frog->direction = 'R';
-        frog->last_jump_time = clock();
+    }
+    frog->x = x;
+    frog->y = game_config->height;
+    frog->prev_x = frog->x;
+    frog->prev_y = frog->y;
+    frog->direction = 'U';
+    frog->last_jump_time = now;
 }
 
-void frog_move_left(GameConfig* game_config, Frog* frog){
-    if (frog->x > 2) {
-            if(game_config->board[frog->y - 1][frog->x - 3] != 'O' && game_config->board[frog->y - 1][frog->x - 2] != 'O'){         //checking if frog doesnt want to jump onto an obstacle
-                frog->x -= 2;
-                frog->moves++;
-            } 
-            else if(game_config->board[frog->y - 1][frog->x - 2] != 'O'){                            //if obstacle is half a normal movement in x-axis away then take a smaller jump
-                frog->x -= 1;
-                frog->moves++;
-            }
-        }
-        else if(frog->x > 1){                                                                        //if game border is half a normal movement in x-axis away then do a smaller jump
-            if(game_config->board[frog->y - 1][frog->x - 1] != 'O'){
-                frog->x -= 1;
-                frog->moves++;
-            }
-        }
-        frog->direction = 'L';
-        frog->last_jump_time = clock();
+size_t crowd_bytes(GameConfig *game_config, int frog_count){
+    return round_bytes(game_config) + arena_aligned(frog_count * sizeof(Frog)) + pool_bytes(frog_count) + car_index_bytes(game_config);
 }
 
-void frogs_move(GameConfig* game_config, Frog* frog, int movement) {
-    if(can_frog_jump(game_config, frog) == false && movement != 'e' && movement != 't'){
-        return;
-    }
-    else if(frog->is_carried == true){ //frog can't move when its being carried by a car
-        return;
-    }
-    
-    //If frog is allowed to jump, then update its position and last_jump_time for the present time (provided that it is not jumping onto an obstacle)
-    //Frog is 2x wide, that's why there are two conditions for its x
-    //We have to substract 1 from frog->y due to the board shift
-    switch (movement) {
-    case KEY_UP:
-        frog_move_up(game_config, frog);
-        break;
-    case KEY_DOWN:
-        frog_move_down(game_config, frog);
-        break;
-    case KEY_RIGHT:
-        frog_move_right(game_config, frog);
-        break;
-    case KEY_LEFT:
-        frog_move_left(game_config, frog);
-        break;
+void setup_crowd(Crowd *crowd, Frog *loaded_frog, int frog_count){
+    GameConfig *game_config = crowd->game_config;
+    arena_reset(&crowd->arena);
+    arena_reserve(&crowd->arena, crowd_bytes(game_config, frog_count));
+    Frog *frog;
+    setup_round(game_config, &crowd->arena, loaded_frog, crowd->roads_pos, &frog, &crowd->cars, &crowd->storks, &crowd->cars_on_lane, &crowd->free_lanes, &crowd->lane_directions);
+
+    //the round is set up for one frog, the crowd takes over the frog pool
+    crowd->frogs = (Frog*)arena_alloc(&crowd->arena, frog_count * sizeof(Frog));
+    init_pool(&game_config->frog_pool, frog_count, &crowd->arena);
+    for(int i = 0; i < frog_count; i++){
+        Frog *crowd_frog = &crowd->frogs[spawn_entity(&game_config->frog_pool)];
+        *crowd_frog = *frog;
+        place_crowd_frog(game_config, crowd_frog, game_clock());
     }
-
+    crowd->frog_count = frog_count;
+    init_car_index(&crowd->index, game_config, &crowd->arena);
+    build_car_index(&crowd->index, game_config, crowd->cars);
+    build_goal_distance(game_config, crowd->goal_distance);
+    crowd->wins = 0;
+    crowd->deaths = 0;
 }
 
+void rebuild_frogs_plane(GameConfig *game_config, Frog *frogs, int frog_count){
+    memset(game_config->board.frogs, 0, sizeof(game_config->board.frogs));
+    for(int i = 0; i < frog_count; i++){
+        set_bits(game_config->board.frogs[frogs[i].y - 1], frogs[i].x - 1, 1);
+    }
+}
 
-            //SECTION OF CARS MOVEMENT
+            //ONE FRAME - THE FROGS JUMP, THE CARS MOVE, THEN EVERY FROG IS CHECKED AGAINST THE CARS AROUND IT
+//the storks only chase the first frog, one flow field per frog would cost more than all the rest
+template<int MODE>
+void crowd_tick(Crowd *crowd, clock_t now){
+    GameConfig *game_config = crowd->game_config;
+    Frog *frogs = crowd->frogs;
+    for(int i = 0; i < crowd->frog_count; i++){
+        frogs[i].prev_x = frogs[i].x;
+        frogs[i].prev_y = frogs[i].y;
+        int key = player_key(game_config, &frogs[i], crowd->cars, &crowd->index, now, crowd->goal_distance);
+        if(key != ERR){
+            apply_key<MODE | MODE_CROWD>(game_config, &frogs[i], crowd->cars, key, now);
+        }
+    }
+    rebuild_frogs_plane(game_config, frogs, crowd->frog_count);
+    cars_move<MODE | MODE_CROWD>(game_config, crowd->cars, &frogs[0], crowd->roads_pos, crowd->cars_on_lane, &crowd->free_lanes, crowd->lane_directions);
+    build_car_index(&crowd->index, game_config, crowd->cars);
+    if(MODE & MODE_STORKS){
+        move_storks(game_config, crowd->storks, &frogs[0]);
+    }
 
-bool car_visibility_check(GameConfig *game_config, Car *car, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
-    if(car->hidden == true){
-        if(clock() >= car->hidden_until){
-            car->hidden = false;
-            change_car_position(car, game_config, roads_pos, cars_on_lane, free_lanes, lane_directions);
+    for(int i = 0; i < crowd->frog_count; i++){
+        if(frogs[i].y == 1){
+            crowd->wins++;
+        }
+        else if(is_indexed_frog_hit<MODE>(&frogs[i], crowd->cars, &crowd->index) || ((MODE & MODE_STORKS) && check_storks_collision(game_config, &frogs[i], crowd->storks))){
+            crowd->deaths++;
         }
         else{
-            return false;
+            continue;
         }
+        place_crowd_frog(game_config, &frogs[i], now);
     }
-    return true;
 }
 
-void manage_lanes(GameConfig *game_config, Car *car, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
-    int current_lane = -1;
-    for(int i = 0; i < game_config->road_lanes; i++){
-        if(car->y == (roads_pos[i] + 1)){ 
-            current_lane = i;
-            break;
+typedef void (*CrowdTick)(Crowd*, clock_t);
+
+//endless levels scroll under one frog, a crowd can't play them
+const CrowdTick crowd_ticks[GAME_MODES] = {
+    crowd_tick<0>, crowd_tick<1>, crowd_tick<2>, crowd_tick<3>,
+    crowd_tick<4>, crowd_tick<5>, crowd_tick<6>, crowd_tick<7>,
+};
+
+void publish_crowd_frame(SpectatorRing *ring, Crowd *crowd, int time_elapsed){
+    SpectatorSlot *slot = begin_spectator_frame(ring);
+    int count = 0;
+    for(int i = 0; i < crowd->frog_count && count < SPECTATOR_ENTITIES; i++){
+        slot->entities[count].x = crowd->frogs[i].x;
+        slot->entities[count].y = crowd->frogs[i].y;
+        slot->entities[count].sprite = frog_sprite(&crowd->frogs[i]);
+        count++;
+    }
+    for(int i = 0; i < crowd->game_config->car_pool.count && count < SPECTATOR_ENTITIES; i++){
+        slot->entities[count].x = crowd->cars[i].x;
+        slot->entities[count].y = crowd->cars[i].y;
+        slot->entities[count].sprite = car_sprite(&crowd->cars[i]);
+        count++;
+    }
+    for(int i = 0; i < crowd->game_config->stork_count && count < SPECTATOR_ENTITIES; i++){
+        if(crowd->storks[i].alive == true){
+            slot->entities[count].x = crowd->storks[i].x;
+            slot->entities[count].y = crowd->storks[i].y;
+            slot->entities[count].sprite = SPRITE_STORK;
+            count++;
         }
     }
+    slot->count = count;
+    slot->moves = (int)crowd->wins;
+    slot->time_elapsed = time_elapsed;
+    end_spectator_frame(ring, slot);
+}
 
-    //counting how many cars are on the lanes and how many lanes without cars there are
-    cars_on_lane[current_lane]--;
-            if(cars_on_lane[current_lane] == 0){
-                (*free_lanes)++;
-            }
-            car->hidden = true;
-            car->hidden_until = clock() + (rand() % 1000 + 500) * CLOCKS_PER_SEC / 1000;                   //random delay between 0.5 and 1.5 seconds
-            car->x = game_config->width + 5;                                                               //placing car outside of the board so the frog won't step into it by an accident
-            car->y = game_config->height + 5;
+void report_crowd(Crowd *crowd, int ticks, double tick_time, double max_tick_time){
+    printf("frogs: %d, cars: %d, tick: %.2f ms (max %.2f ms), wins: %lld, deaths: %lld\n",
+           crowd->frog_count, crowd->game_config->car_pool.count, ticks > 0 ? tick_time / ticks : 0.0, max_tick_time, crowd->wins, crowd->deaths);
+    fflush(stdout);
 }
 
-                //WHAT HAPPENS TO A CAR WHEN IT HITS THE BORDER
-bool hits_the_border(GameConfig *game_config, Car *car){
-    if(car->x <= 1 || (car->x + CAR_WIDTH - 2) >= game_config->width){
-        return true;
+//a frame every FRAME_TIME ms like the game, the statistics every CROWD_REPORT_TIME ms
+int run_crowd(const char *config_file, int frog_count, int seconds, const char *broadcast_name){
+    Crowd *crowd = new Crowd;
+    crowd->game_config = new GameConfig();
+    GameConfig *game_config = crowd->game_config;
+    if(strlen(config_file) >= sizeof(game_config->file_name) || frog_count < 1 || frog_count > MAX_CROWD || seconds < 1){
+        std::cerr << "Usage: --crowd CONFIG FROGS [SECONDS] [BROADCAST_NAME]\n";
+        return 1;
     }
-    else{
-        return false;
+    strcpy(game_config->file_name, config_file);
+    Frog loaded_frog;
+    if(load_level(game_config, &loaded_frog, crowd->roads_pos) == false){
+        std::cerr << "Somethings wrong with the given data in the config file.\n" << game_config->error << "\n";
+        return 1;
+    }
+    if(game_config->endless == true){
+        std::cerr << "Endless levels scroll under one frog, a crowd can't play them.\n";
+        return 1;
+    }
+    game_config->rng = 1;
+    SpectatorRing *ring = NULL;
+    if(broadcast_name != NULL){
+        ring = open_spectator_ring(broadcast_name);
+        if(ring == NULL){
+            perror(broadcast_name);
+            return 1;
+        }
+    }
+    init_arena(&crowd->arena, ARENA_START_SIZE);
+    setup_crowd(crowd, &loaded_frog, frog_count);
+    if(ring != NULL){
+        publish_board(ring, &game_config->board, game_config->width, game_config->height);
     }
-}
 
-void cars_destiny(GameConfig *game_config, Car* car, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
-    if(rand() % 3 == 0){
-                if(car->direction == 1){
-                    car->x = 1;
-                }
-                else{
-                    car->x = game_config->width - CAR_WIDTH;
-                }                                                                                               //the car wrapps (33% chance)
-            }
-            else{                                                                                               //the car changes lane (66% chance)
-                manage_lanes(game_config, car, roads_pos, cars_on_lane, free_lanes, lane_directions);
-            }
+    CrowdTick tick = crowd_ticks[game_mode(game_config)];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point next_frame = start, next_report = start + std::chrono::milliseconds(CROWD_REPORT_TIME);
+    std::chrono::steady_clock::time_point end = start + std::chrono::seconds(seconds);
+    int ticks = 0;
+    double tick_time = 0, max_tick_time = 0;
+    while(next_frame < end){
+        std::this_thread::sleep_until(next_frame);
+        next_frame += std::chrono::milliseconds(FRAME_TIME);
+
+        std::chrono::steady_clock::time_point tick_start = std::chrono::steady_clock::now();
+        tick(crowd, game_clock());
+        double time = microseconds_since(tick_start, 1000);
+        if(metrics != NULL){
+            CarsSample sample;
+            init_cars_sample(&sample);
+            sample_cars(&sample, game_config, crowd->cars_on_lane);
+            store_cars(&sample);
+            count_frame((long long)(time * 1000));
+        }
+        ticks++;
+        tick_time += time;
+        if(time > max_tick_time){
+            max_tick_time = time;
+        }
+        if(ring != NULL){
+            publish_crowd_frame(ring, crowd, (int)microseconds_since(start, 1000));
+        }
+
+        if(std::chrono::steady_clock::now() >= next_report){
+            report_crowd(crowd, ticks, tick_time, max_tick_time);
+            next_report += std::chrono::milliseconds(CROWD_REPORT_TIME);
+            ticks = 0;
+            tick_time = 0;
+            max_tick_time = 0;
+        }
+    }
+    clear_cars();
+
+    if(ring != NULL){
+        close_spectator_ring(ring, broadcast_name);
+    }
+    free_arena(&crowd->arena);
+    delete game_config;
+    delete crowd;
+    return 0;
 }
 
-//MAIN FUNCTION OF CARS POSITION
 
-bool cars_friendly_and_neutral_move(GameConfig *game_config, Frog *frog, Car *car){
-    //friendly and neutral cars dont move when the frog is close and directed to them
-    if (frog->direction == 'U' && (frog->y >= car->y)) {
-        return false;
+//EVENT LOG READER (--read-log LOG [PREFIX]), CSV on the standard output, or with PREFIX one raw little-endian array per column
+const char *event_names[EVENT_TYPES] = {
+    "jump", "blocked_jump", "enter_car", "leave_car", "lane_change",
+    "car_hide", "car_respawn", "delay_change", "death", "score",
+};
+
+typedef struct {
+    const char *name;
+    size_t offset, size;
+} EventColumn;
+
+const EventColumn event_columns[] = {
+    {"time", offsetof(GameEvent, time), sizeof(unsigned int)},
+    {"type", offsetof(GameEvent, type), sizeof(unsigned char)},
+    {"entity", offsetof(GameEvent, entity), sizeof(char)},
+    {"thread", offsetof(GameEvent, thread), sizeof(unsigned char)},
+    {"detail", offsetof(GameEvent, detail), sizeof(char)},
+    {"x", offsetof(GameEvent, x), sizeof(short)},
+    {"y", offsetof(GameEvent, y), sizeof(short)},
+    {"value", offsetof(GameEvent, value), sizeof(int)},
+};
+#define EVENT_COLUMNS ((int)(sizeof(event_columns) / sizeof(event_columns[0])))
+
+void print_event_csv(GameEvent *event){
+    printf("%u,%u,%s,%c,%c,%d,%d,%d\n", event->time, event->thread,
+           event->type < EVENT_TYPES ? event_names[event->type] : "unknown",
+           event->entity != 0 ? event->entity : '-', event->detail != 0 ? event->detail : '-', event->x, event->y, event->value);
+}
+
+int read_event_log(const char *file_name, const char *prefix){
+    FILE *file = fopen(file_name, "rb");
+    if(file == NULL){
+        perror(file_name);
+        return 1;
     }
-    else if (frog->direction == 'D' && frog->y <= car->y + 1) {
-        return false;
+    EventLogHeader header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != EVENT_LOG_MAGIC || header.record_size != (int)sizeof(GameEvent)){
+        std::cerr << file_name << " is not an event log of this version.\n";
+        fclose(file);
+        return 1;
     }
-    if (frog->direction == 'L' && (frog->x + 1 < car->x && car->direction == -1) || (frog->x > car->x + CAR_WIDTH - 1 && car->direction == 1)) {
-        if(frog->y == car->y || frog->y == car->y + 1){
-            return false;
+
+    FILE *columns[EVENT_COLUMNS];
+    for(int i = 0; prefix != NULL && i < EVENT_COLUMNS; i++){
+        char column_name[MAX_LINE_LENGTH];
+        snprintf(column_name, sizeof(column_name), "%s.%s", prefix, event_columns[i].name);
+        columns[i] = fopen(column_name, "wb");
+        if(columns[i] == NULL){
+            perror(column_name);
+            return 1;
         }
     }
-    if (frog->direction == 'R' && (frog->x + 2 >= car->x && car->direction == -1) || (frog->x >= car->x + CAR_WIDTH - 1 && car->direction == 1)) {
-        if(frog->y == car->y || frog->y == car->y + 1){
-            return false;
+    if(prefix == NULL){
+        printf("time_ms,thread,event,entity,detail,x,y,value\n");
+    }
+
+    GameEvent events[1024];
+    long long total = 0;
+    size_t count;
+    while((count = fread(events, sizeof(GameEvent), 1024, file)) > 0){
+        for(size_t i = 0; i < count; i++){
+            if(prefix == NULL){
+                print_event_csv(&events[i]);
+                continue;
+            }
+            for(int c = 0; c < EVENT_COLUMNS; c++){
+                fwrite((char*)&events[i] + event_columns[c].offset, event_columns[c].size, 1, columns[c]);
+            }
         }
+        total += count;
     }
-    return true;
+    for(int i = 0; prefix != NULL && i < EVENT_COLUMNS; i++){
+        fclose(columns[i]);
+    }
+    fclose(file);
+    fprintf(stderr, "%lld events, %lld dropped\n", total, header.dropped);
+    return 0;
 }
 
-bool is_shant(GameConfig *game_config, Car *car, Car *cars){
-    int car_i_pos = 0;
-    for(int i = 0; i < game_config->car_number; i++){
-        if(&cars[i] == car){
-            car_i_pos = i;
+//BENCHMARK OF THE EVENT LOG (--bench-log [events]), the time the game thread pays for one event
+//events are logged in bursts of half a ring and the writer gets time to empty it in between, so nothing is dropped
+int bench_event_log(long long event_count){
+    char file_name[] = "/tmp/frogger-events-XXXXXX";
+    int fd = mkstemp(file_name);
+    if(fd < 0 || open_event_log(file_name) == false){
+        perror(file_name);
+        return 1;
+    }
+    close(fd);
+    event_clock = game_clock();
+    double logging = 0;
+    long long logged = 0;
+    while(logged < event_count){
+        int burst = EVENT_RING_SIZE / 2;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int i = 0; i < burst; i++){
+            log_event(EVENT_JUMP, 'F', 'U', i & 63, i & 31, i);
+        }
+        logging += microseconds_since(start, 1);
+        logged += burst;
+        while(event_ring->tail.load(std::memory_order_acquire) != event_ring->head.load(std::memory_order_relaxed)){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
     }
+    long long written = event_log->written;
+    close_event_log();
+    struct stat file_stat;
+    stat(file_name, &file_stat);
+    unlink(file_name);
+    printf("events: %lld, %.1f ns per event in the game thread\n", logged, logging * 1000 / logged);
+    printf("written: %lld (%lld bytes), %d bytes per event\n", written, (long long)file_stat.st_size, (int)sizeof(GameEvent));
+    return 0;
+}
 
-    for(int i = 0; i < game_config->car_number; i++){
-        if(i != car_i_pos){
-            if (cars[i].y == car->y) { 
-                if (car->direction == 1 && cars[i].x > car->x && cars[i].x - car->x <= CAR_WIDTH) {
-                    return true;
-                } 
-                else if (car->direction == -1 && cars[i].x < car->x && car->x - cars[i].x <= CAR_WIDTH) {
-                    return true;
-                }
+
+            //SOCKETS
+//thousands of sessions need thousands of descriptors
+void raise_file_limit(){
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+//address is ":port" for TCP on the loopback interface, anything else is the path of a Unix socket
+int open_socket(const char *address, bool listening){
+    int fd, result;
+    int one = 1;
+    if(address[0] == ':'){
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0){
+            return -1;
+        }
+        struct sockaddr_in inet_address;
+        memset(&inet_address, 0, sizeof(inet_address));
+        inet_address.sin_family = AF_INET;
+        inet_address.sin_port = htons(atoi(address + 1));
+        inet_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if(listening){
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            result = bind(fd, (struct sockaddr*)&inet_address, sizeof(inet_address));
+        }
+        else{
+            result = connect(fd, (struct sockaddr*)&inet_address, sizeof(inet_address));
+        }
+    }
+    else{
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0){
+            return -1;
+        }
+        struct sockaddr_un unix_address;
+        memset(&unix_address, 0, sizeof(unix_address));
+        unix_address.sun_family = AF_UNIX;
+        strncpy(unix_address.sun_path, address, sizeof(unix_address.sun_path) - 1);
+        if(listening){
+            struct stat info;
+            if(stat(address, &info) == 0 && S_ISSOCK(info.st_mode)){
+                unlink(address);        //left by a server that didn't get to clean up; any other file stays and bind fails
             }
+            result = bind(fd, (struct sockaddr*)&unix_address, sizeof(unix_address));
+        }
+        else{
+            result = connect(fd, (struct sockaddr*)&unix_address, sizeof(unix_address));
         }
     }
-    return false;
+    if(result < 0 || (listening && listen(fd, SOMAXCONN) < 0)){
+        close(fd);
+        return -1;
+    }
+    return fd;
 }
 
-void update_car_pos(GameConfig *game_config, Car *car, Car *cars, Frog *frog, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
-                                        //checks whether car should be shown
-    if(car_visibility_check(game_config, car, roads_pos, cars_on_lane, free_lanes, lane_directions) == false){
-        return;
+            //METRICS ENDPOINT - PROMETHEUS TEXT FORMAT OVER HTTP, ON A LOCALHOST PORT OR A UNIX SOCKET
+int append_text(char *out, int length, const char *format, ...){
+    if(length >= METRICS_BUFFER){
+        return length;
     }
+    va_list arguments;
+    va_start(arguments, format);
+    int written = vsnprintf(out + length, METRICS_BUFFER - length, format, arguments);
+    va_end(arguments);
+    return written > 0 ? length + written : length;
+}
 
-    if(car->car_type == 'n' && is_frog_near(frog, car) || (car->car_type == 'f' && is_frog_near(frog, car) && car->carrying_frog == false)){    
-        //if(cars_friendly_and_neutral_move(game_config, frog, car) == false){
-        return;
-        //}
+void add_histogram(HistogramTotal *total, Histogram *histogram){
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++){
+        total->buckets[i] += histogram->buckets[i].load(std::memory_order_relaxed);
     }
+    total->count += histogram->count.load(std::memory_order_relaxed);
+    total->sum += histogram->sum.load(std::memory_order_relaxed);
+}
 
-    if(is_shant(game_config, car, cars) == true){ //if a car would ride "into" a car that is ahead of it then stop its movement
-        return;
+int append_histogram(char *out, int length, const char *name, const char *help, HistogramTotal *total){
+    length = append_text(out, length, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    long long cumulative = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++){
+        cumulative += total->buckets[i];
+        length = append_text(out, length, "%s_bucket{le=\"%g\"} %lld\n", name, histogram_bounds[i] / 1e6, cumulative);
     }
+    length = append_text(out, length, "%s_bucket{le=\"+Inf\"} %lld\n", name, total->count);
+    length = append_text(out, length, "%s_sum %g\n%s_count %lld\n", name, total->sum / 1e6, name, total->count);
+    return length;
+}
 
-    if(car->carrying_frog == false){
-        car->x += car->direction;
+//upper bound of the bucket the quantile falls into
+int append_quantile(char *out, int length, const char *name, HistogramTotal *total, double quantile){
+    if(total->count == 0){
+        return append_text(out, length, "%s{quantile=\"%g\"} NaN\n", name, quantile);
+    }
+    long long rank = (long long)(quantile * total->count + 0.5);
+    long long cumulative = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++){
+        cumulative += total->buckets[i];
+        if(cumulative >= rank){
+            return append_text(out, length, "%s{quantile=\"%g\"} %g\n", name, quantile, histogram_bounds[i] / 1e6);
+        }
+    }
+    return append_text(out, length, "%s{quantile=\"%g\"} +Inf\n", name, quantile);
+}
 
-        if(hits_the_border(game_config, car) == true){
-            cars_destiny(game_config, car, roads_pos, cars_on_lane, free_lanes, lane_directions);
+//adds up the blocks of all the threads; they go on counting meanwhile, so the totals are only as exact as a scrape needs
+int format_metrics(char *out){
+    HistogramTotal frame_time, score_write;
+    memset(&frame_time, 0, sizeof(frame_time));
+    memset(&score_write, 0, sizeof(score_write));
+    long long ticks = 0;
+    int sessions = 0, cars_active = 0, cars_hidden = 0, lanes = 0;
+    int lane_cars[MAX_NUM];
+    memset(lane_cars, 0, sizeof(lane_cars));
+
+    int count = metrics->thread_count.load(std::memory_order_acquire);
+    for(int i = 0; i < count; i++){
+        ThreadMetrics *block = metrics->threads[i];
+        ticks += block->ticks.load(std::memory_order_relaxed);
+        add_histogram(&frame_time, &block->frame_time);
+        add_histogram(&score_write, &block->score_write);
+        sessions += block->sessions.load(std::memory_order_relaxed);
+        cars_active += block->cars_active.load(std::memory_order_relaxed);
+        cars_hidden += block->cars_hidden.load(std::memory_order_relaxed);
+        int block_lanes = block->lanes.load(std::memory_order_acquire);
+        for(int lane = 0; lane < block_lanes; lane++){
+            lane_cars[lane] += block->lane_cars[lane].load(std::memory_order_relaxed);
+        }
+        if(block_lanes > lanes){
+            lanes = block_lanes;
         }
     }
-    else{                                  //when a car carries the frog then it can't dissapear when close to the border, it has to wait for frog to get out of the car
-         if(car->x + 1 > 1 && (car->x + CAR_WIDTH - 1) < game_config->width){
-            car->x += car->direction;
+
+    int length = 0;
+    length = append_text(out, length, "# HELP frogger_ticks_total Frames simulated, a server worker counts one for all of its sessions.\n# TYPE frogger_ticks_total counter\nfrogger_ticks_total %lld\n", ticks);
+    length = append_histogram(out, length, "frogger_frame_seconds", "Time the simulation of a frame took.", &frame_time);
+    length = append_text(out, length, "# HELP frogger_frame_quantile_seconds Quantiles of frogger_frame_seconds, the upper bound of the bucket they fall into.\n# TYPE frogger_frame_quantile_seconds gauge\n");
+    length = append_quantile(out, length, "frogger_frame_quantile_seconds", &frame_time, 0.5);
+    length = append_quantile(out, length, "frogger_frame_quantile_seconds", &frame_time, 0.9);
+    length = append_quantile(out, length, "frogger_frame_quantile_seconds", &frame_time, 0.99);
+    length = append_histogram(out, length, "frogger_score_write_seconds", "Time an append to the leaderboard file took.", &score_write);
+    length = append_text(out, length, "# HELP frogger_sessions_running Rounds being played, one for the game or every running session of the server.\n# TYPE frogger_sessions_running gauge\nfrogger_sessions_running %d\n", sessions);
+    length = append_text(out, length, "# HELP frogger_cars_active Cars on the boards.\n# TYPE frogger_cars_active gauge\nfrogger_cars_active %d\n", cars_active);
+    length = append_text(out, length, "# HELP frogger_cars_hidden Cars waiting to come back on a lane.\n# TYPE frogger_cars_hidden gauge\nfrogger_cars_hidden %d\n", cars_hidden);
+    length = append_text(out, length, "# HELP frogger_lane_cars Cars on every lane (cars_on_lane), added up over the sessions.\n# TYPE frogger_lane_cars gauge\n");
+    for(int lane = 0; lane < lanes; lane++){
+        length = append_text(out, length, "frogger_lane_cars{lane=\"%d\"} %d\n", lane, lane_cars[lane]);
+    }
+    return length < METRICS_BUFFER ? length : METRICS_BUFFER - 1;
+}
+
+bool write_all(int fd, const char *data, int length){
+    while(length > 0){
+        int written = write(fd, data, length);
+        if(written <= 0){
+            return false;
         }
-        else{
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+//every request gets the same page, whatever it asks for
+void answer_scrape(int fd){
+    char request[1024];
+    struct pollfd client = {fd, POLLIN, 0};
+    if(poll(&client, 1, 1000) > 0){
+        if(read(fd, request, sizeof(request)) < 0){
             return;
         }
     }
+    int length = format_metrics(metrics->page);
+    char header[MAX_LINE_LENGTH];
+    int header_length = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", length);
+    if(write_all(fd, header, header_length)){
+        write_all(fd, metrics->page, length);
+    }
 }
 
-void change_car_delay(GameConfig *game_config, Car *car){
-    if(clock() >= car->until_delay_change){
-        car->delay = (rand() % (game_config->max_car_delay - game_config->min_car_delay)) + game_config->min_car_delay;
-        
-        car->until_delay_change = clock() + ((rand() % DELAY_CHANGE_T) + DELAY_CHANGE_T) * CLOCKS_PER_SEC / 1000;
+void serve_metrics(){
+    while(metrics->running.load()){
+        struct pollfd listener = {metrics->listener, POLLIN, 0};
+        if(poll(&listener, 1, METRICS_POLL_TIME) <= 0){
+            continue;
+        }
+        int fd = accept(metrics->listener, NULL, NULL);
+        if(fd >= 0){
+            answer_scrape(fd);
+            close(fd);
+        }
     }
 }
 
-void cars_move(GameConfig *game_config, Car* cars, Frog* frog, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
-    for(int i = 0; i < game_config->car_number; i++){
-        if((clock() - cars[i].last_move_time) * 1000 / CLOCKS_PER_SEC >= cars[i].delay){
-            //updates cars position on the board
-            update_car_pos(game_config, &cars[i], cars, frog, roads_pos, cars_on_lane, free_lanes, lane_directions);
-            cars[i].last_move_time = clock();
+//address like in --server: :PORT for localhost, anything else is the path of a Unix socket
+bool start_metrics(const char *address){
+    if(strlen(address) >= MAX_LINE_LENGTH){
+        return false;
+    }
+    int listener = open_socket(address, true);
+    if(listener < 0){
+        return false;
+    }
+    metrics = new Metrics();
+    metrics->listener = listener;
+    strcpy(metrics->address, address);
+    metrics->thread_count.store(0);
+    metrics->running.store(true);
+    metrics->endpoint = std::thread(serve_metrics);
+    return true;
+}
 
-            //checks whether enought time has passed for car to have another delay (meaning another speed)
-            change_car_delay(game_config, &cars[i]);
-        }
+//when nothing counts anymore
+void stop_metrics(){
+    metrics->running.store(false);
+    metrics->endpoint.join();
+    close(metrics->listener);
+    if(metrics->address[0] != ':'){
+        unlink(metrics->address);
+    }
+    for(int i = 0; i < metrics->thread_count.load(); i++){
+        delete metrics->threads[i];
     }
+    delete metrics;
+    metrics = NULL;
+    thread_metrics = NULL;
 }
 
+//keys and acks from the clients; a message that doesn't fit into the socket is dropped, the next ack covers a lost one
+void send_message(int fd, int type, int value){
+    char message[sizeof(NetHeader) + sizeof(int)];
+    NetHeader header = {(int)sizeof(message), type};
+    memcpy(message, &header, sizeof(header));
+    memcpy(message + sizeof(header), &value, sizeof(int));
+    send(fd, message, sizeof(message), MSG_NOSIGNAL);
+}
 
-// MAIN GAME CONDITIONS - WHETHER FROG IS STILL ALIVE OR NOT
 
-void update_invincibility(Frog *frog) {
-    if (frog->is_invincible) {
-        if ((clock() - frog->invincibility_start) * 1000 / CLOCKS_PER_SEC >= INVINCIBILITY_TIME) { 
-            frog->is_invincible = false;
-        }
+            //GAME SERVER - MANY GAMES IN ONE PROCESS, STEPPED BY A POOL OF WORKERS
+//the network thread pushes, the worker of the session pops
+void push_session_key(Session *session, int key, clock_t time){
+    unsigned int tail = session->key_tail.load(std::memory_order_relaxed);
+    if(tail - session->key_head.load(std::memory_order_acquire) == SESSION_KEYS){
+        return;
     }
+    session->keys[tail % SESSION_KEYS].key = key;
+    session->keys[tail % SESSION_KEYS].time = time;
+    session->key_tail.store(tail + 1, std::memory_order_release);
 }
 
-bool check_collision(Frog *frog, Car *cars, GameConfig *game_config){
-    if(frog->is_carried == true){
+bool pop_session_key(Session *session, KeyEvent *event){
+    unsigned int head = session->key_head.load(std::memory_order_relaxed);
+    if(head == session->key_tail.load(std::memory_order_acquire)){
         return false;
     }
-    if(frog->is_invincible == true){
+    *event = session->keys[head % SESSION_KEYS];
+    session->key_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void start_session_round(Server *server, Session *session){
+    arena_reset(&session->arena);
+    setup_round(session->game_config, &session->arena, &server->level_frog, server->roads_pos, &session->frog, &session->cars, &session->storks, &session->cars_on_lane, &session->free_lanes, &session->lane_directions);
+    session->start_time = game_clock();
+}
+
+int level_message(Server *server, char *out){
+    GameConfig *level = server->level;
+    NetHeader header = {(int)(sizeof(NetHeader) + sizeof(NetLevel)) + level->width * level->height, NET_LEVEL};
+    NetLevel body = {level->width, level->height, server->entity_count};
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), &body, sizeof(body));
+    char *fields = out + sizeof(header) + sizeof(body);
+    for(int i = 0; i < level->height; i++){
+        for(int j = 0; j < level->width; j++){
+            fields[i * level->width + j] = board_field(level, i, j);
+        }
+    }
+    return header.length;
+}
+
+//called by the network thread, the session starts with the level message waiting to be sent
+bool open_session(Server *server, int fd){
+    int index = 0;
+    while(index < server->session_count && server->sessions[index].state.load(std::memory_order_acquire) != SESSION_FREE){
+        index++;
+    }
+    if(index == server->session_count){
         return false;
     }
 
-    for(int i = 0; i < game_config->car_number; i++){
-        int frog_left = frog->x;
-        int frog_right = frog->x + 1;
-        int frog_y_axis = frog->y;
+    Session *session = &server->sessions[index];
+    session->fd = fd;
+    session->game_config = new GameConfig;
+    *session->game_config = *server->level;
+    session->game_config->rng = rand();
+    init_arena(&session->arena, round_bytes(server->level));
+    session->history = new NetEntity[NET_HISTORY * server->entity_count];
+    session->out = new char[server->max_message];
+    start_session_round(server, session);
+    session->mode = game_mode(session->game_config);
+    session->key_head.store(0);
+    session->key_tail.store(0);
+    session->in_length = 0;
+    session->acked.store(-1);
+    session->frame = 0;
+    session->out_start = 0;
+    session->out_end = level_message(server, session->out);
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP;
+    session->generation++;
+    event.data.u64 = (unsigned long long)session->generation << 32 | (index + 1);
+    epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event);
+    session->state.store(SESSION_RUNNING, std::memory_order_release);
+    return true;
+}
 
-        int car_left = cars[i].x;
-        int car_right = cars[i].x + CAR_WIDTH - 1;
-        int car_top = cars[i].y;
-        int car_bottom = cars[i].y + CAR_HEIGHT - 1;
+//called by the worker of the session once the network thread has seen the client go
+void close_session(Server *server, Session *session){
+    epoll_ctl(server->epoll, EPOLL_CTL_DEL, session->fd, NULL);
+    close(session->fd);
+    delete session->game_config;
+    free_arena(&session->arena);
+    delete[] session->history;
+    delete[] session->out;
+    session->state.store(SESSION_FREE, std::memory_order_release);
+}
 
-        if (frog_right >= car_left && frog_left <= car_right &&
-            frog_y_axis >= car_top && frog_y_axis <= car_bottom) {
-            return true;
+//only a running session is marked, so a slot the worker has already freed can't be closed a second time
+void mark_session_closing(Session *session){
+    int running = SESSION_RUNNING;
+    session->state.compare_exchange_strong(running, SESSION_CLOSING, std::memory_order_acq_rel);
+}
+
+//a whole message from the client; the ones the server doesn't know (or of the wrong length) are skipped
+void client_message(Session *session, NetHeader *header, clock_t time){
+    if(header->length != (int)(sizeof(NetHeader) + sizeof(int))){
+        return;
+    }
+    int value;
+    memcpy(&value, session->in + sizeof(NetHeader), sizeof(int));
+    if(header->type == NET_KEY){
+        push_session_key(session, value, time);
+    }
+    else if(header->type == NET_ACK && value > session->acked.load(std::memory_order_relaxed)){
+        session->acked.store(value, std::memory_order_release);
+    }
+}
+
+void read_session(Session *session){
+    char buffer[512];
+    for(;;){
+        int count = recv(session->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if(count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)){
+            return;
+        }
+        if(count <= 0){
+            mark_session_closing(session);
+            return;
+        }
+        clock_t time = game_clock();
+        for(int i = 0; i < count; i++){
+            session->in[session->in_length++] = buffer[i];
+            if(session->in_length < (int)sizeof(NetHeader)){
+                continue;
+            }
+            NetHeader header;
+            memcpy(&header, session->in, sizeof(header));
+            if(header.length < (int)sizeof(NetHeader) || header.length > NET_CLIENT_MESSAGE){
+                mark_session_closing(session);      //the start of the next message can't be found anymore
+                return;
+            }
+            if(session->in_length < header.length){
+                continue;
+            }
+            client_message(session, &header, time);
+            session->in_length = 0;
         }
     }
-    return false;
 }
 
-char check_game_status(WINDOW* game_window, GameConfig* game_config, Frog* frog, Car* cars, Stork *stork, int time_elapsed) {           //n - nothing's changed; l - game lost; w - game won
-    if (frog->y == 1) {
-        mvwprintw(game_window, game_config->height / 2, game_config->width / 2 - 5, "YOU WON!");
-        wrefresh(game_window);
-        calculate_score(time_elapsed, frog);
+//the entities of the session as the client draws them, indexed by their id
+void collect_entities(Session *session, NetEntity entities[], int entity_count){
+    GameConfig *game_config = session->game_config;
+    memset(entities, 0, entity_count * sizeof(NetEntity));
+    for(int id = 0; id < entity_count; id++){
+        entities[id].sprite = NET_NONE;
+    }
 
-        char name[MAX_NUM];
-        get_player_name(frog, name); 
-        save_score(name, frog->score);   
-        delay(1000);
-        return 'w';
+    Frog *frog = session->frog;
+    if(frog->is_carried == false){
+        entities[0].x = frog->x;
+        entities[0].y = frog->y;
+        entities[0].sprite = frog_sprite(frog);
     }
-    if(check_collision(frog, cars, game_config) == true){
-        mvwprintw(game_window, game_config->height / 2, game_config-> width /2 - 11, "GAME OVER!\tYOU LOST!");
-        wrefresh(game_window);
-        delay(2000);
-        return 'c';
+    for(int i = 0; i < game_config->car_pool.count; i++){
+        NetEntity *entity = &entities[1 + game_config->car_pool.slots[i]];
+        entity->x = session->cars[i].x;
+        entity->y = session->cars[i].y;
+        entity->sprite = car_sprite(&session->cars[i]);
+    }
+    for(int i = 0; i < game_config->stork_pool.count; i++){
+        if(session->storks[i].alive == true){
+            NetEntity *entity = &entities[1 + game_config->car_number + game_config->stork_pool.slots[i]];
+            entity->x = session->storks[i].x;
+            entity->y = session->storks[i].y;
+            entity->sprite = SPRITE_STORK;
+        }
     }
-    if (check_stork_collision(frog, stork)) {
-        mvwprintw(game_window, game_config->height / 2, game_config->width / 2 - 11, "GAME OVER!\tSTORK GOT YOU!");
-        wrefresh(game_window);
-        delay(2000);
-    return false; // Gra kończy się
-}
-    return 'n';
 }
 
-//MAIN GAME LOOP
+//sends what's left of the last message, false while the socket is full (or the client is gone, the network thread will see it)
+bool flush_session(Server *server, Session *session){
+    while(session->out_start < session->out_end){
+        int count = send(session->fd, session->out + session->out_start, session->out_end - session->out_start, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(count <= 0){
+            return false;
+        }
+        session->out_start += count;
+        server->bytes_sent.fetch_add(count, std::memory_order_relaxed);
+    }
+    return true;
+}
 
-            //FROG AND FRIENDLY CARS
-Car *find_near_friendly_car(GameConfig *game_config, Frog* frog, Car *cars){
-    Car *car = NULL;
-    for(int i = 0; i < game_config->car_number; i++){
-        if(cars[i].car_type == 'f'){
-            if(is_frog_near(frog, &cars[i]) == true){
-                car = &cars[i];
-            }
+//only the entities that differ from the frame the client acked are sent; a frame that doesn't fit into the socket is dropped,
+//the next one is again relative to what the client has
+void send_frame(Server *server, Session *session, char status){
+    if(flush_session(server, session) == false){
+        return;
+    }
+    int entity_count = server->entity_count;
+    int frame = session->frame;
+    NetEntity *entities = &session->history[(frame % NET_HISTORY) * entity_count];
+    collect_entities(session, entities, entity_count);
+
+    int base = session->acked.load(std::memory_order_acquire);
+    NetEntity *base_entities = NULL;
+    if(base >= 0 && base < frame && frame - base < NET_HISTORY){
+        base_entities = &session->history[(base % NET_HISTORY) * entity_count];
+    }
+    else{
+        base = -1;
+    }
+
+    char *out = session->out + sizeof(NetHeader) + sizeof(NetFrame);
+    int count = 0;
+    for(int id = 0; id < entity_count; id++){
+        bool changed;
+        if(base_entities == NULL){
+            changed = entities[id].sprite != NET_NONE;
+        }
+        else{
+            changed = memcmp(&entities[id], &base_entities[id], sizeof(NetEntity)) != 0;
+        }
+        if(changed){
+            NetDelta delta;
+            delta.id = id;
+            delta.entity = entities[id];
+            memcpy(out, &delta, sizeof(delta));
+            out += sizeof(delta);
+            count++;
         }
     }
 
-    return car;
+    NetHeader header = {(int)(out - session->out), NET_FRAME};
+    NetFrame body = {frame, base, session->frog->moves, (int)((game_clock() - session->start_time) / CLOCKS_PER_SEC), status, count};
+    memcpy(session->out, &header, sizeof(header));
+    memcpy(session->out + sizeof(header), &body, sizeof(body));
+    session->out_start = 0;
+    session->out_end = header.length;
+    session->frame++;
+    flush_session(server, session);
 }
 
-void frog_gets_in_the_car(GameConfig *game_config, Frog *frog, Car *friendly_car){
-    if(friendly_car != NULL){
-        friendly_car->carrying_frog = true;
-        frog->is_carried = true;
-        frog->x = game_config->width / 2;
-        frog->y = game_config->height + 1;
-        frog->frogs_car = friendly_car;
-    }
-    else{
-        return;
+template<int MODE>
+char step_session(Server *server, Session *session){
+    GameConfig *game_config = session->game_config;
+    Frog *frog = session->frog;
+    frog->prev_x = frog->x;
+    frog->prev_y = frog->y;
+
+    //q and p don't mean anything here, the client just goes away
+    KeyEvent event;
+    while(pop_session_key(session, &event)){
+        apply_key<MODE>(game_config, frog, session->cars, event.key, event.time);
     }
+    game_step<MODE>(game_config, frog, session->cars, session->storks, server->roads_pos, session->cars_on_lane, &session->free_lanes, session->lane_directions);
+    return round_result<MODE>(game_config, frog, session->cars, session->storks);
 }
 
-void frog_gets_out_of_the_car(GameConfig *game_config, Frog *frog){
-    if(frog->frogs_car != NULL){
-        frog->frogs_car->carrying_frog = false;
-        frog->is_carried = false;
-        if(frog->frogs_car->direction == 1){
-            frog->x = frog->frogs_car->x - 1;
+typedef char (*SessionStep)(Server*, Session*);
+
+//endless levels are refused by the server, so there are no steps for them
+const SessionStep session_steps[GAME_MODES] = {
+    step_session<0>, step_session<1>, step_session<2>, step_session<3>,
+    step_session<4>, step_session<5>, step_session<6>, step_session<7>,
+};
+
+//every worker steps its own share of the sessions, all of them once per frame
+void serve_sessions(Server *server, int worker){
+    clock_t frame_length = FRAME_TIME * CLOCKS_PER_SEC / 1000;
+    clock_t next_frame = game_clock();
+    while(server->running.load()){
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        long long steps = 0;
+        CarsSample sample;
+        init_cars_sample(&sample);
+        for(int i = worker; i < server->session_count; i += server->worker_count){
+            Session *session = &server->sessions[i];
+            int state = session->state.load(std::memory_order_acquire);
+            if(state == SESSION_CLOSING){
+                close_session(server, session);
+            }
+            else if(state == SESSION_RUNNING){
+                char result = session_steps[session->mode](server, session);
+                send_frame(server, session, result);
+                if(result != 'n'){
+                    start_session_round(server, session);      //the client shows how the round ended, the next one starts right away
+                }
+                if(metrics != NULL){
+                    sample_cars(&sample, session->game_config, session->cars_on_lane);
+                }
+                steps++;
+            }
         }
-        else{
-            frog->x = frog->frogs_car->x + CAR_WIDTH + 1;
+        long long step_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        server->steps.fetch_add(steps, std::memory_order_relaxed);
+        server->step_time.fetch_add(step_time, std::memory_order_relaxed);
+        if(metrics != NULL){
+            store_cars(&sample);
+            count_frame(step_time / 1000);
         }
-        frog->y = frog->frogs_car->y;
-        frog->is_invincible = true;
-        frog->invincibility_start = clock();
 
-        
-        frog->frogs_car = NULL;
-        return;
+        clock_t now = game_clock();
+        next_frame += frame_length;
+        if(next_frame <= now){
+            next_frame = now + frame_length;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds((long long)(next_frame - now) * 1000000 / CLOCKS_PER_SEC));
     }
-    else{
-        return;
+    clear_cars();
+}
+
+void report_server(Server *server, int seconds){
+    int open = 0;
+    for(int i = 0; i < server->session_count; i++){
+        if(server->sessions[i].state.load(std::memory_order_relaxed) == SESSION_RUNNING){
+            open++;
+        }
     }
+    long long steps = server->steps.exchange(0);
+    long long step_time = server->step_time.exchange(0);
+    long long bytes = server->bytes_sent.exchange(0);
+    fprintf(stderr, "sessions: %d, frames: %lld/s, step: %.2f us per session, sent: %lld B/s\n",
+            open, steps / seconds, steps > 0 ? step_time / 1000.0 / steps : 0.0, bytes / seconds);
 }
 
-bool game_update(WINDOW* game_window, GameConfig* game_config, Frog* frog, Car *cars, Stork* stork, clock_t start_time, int time_elapsed, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]){
-    Car *friendly_car = find_near_friendly_car(game_config, frog, cars);        //if there is a friendly car in proximity of the frog then it is being saved into this variable
+//runs until it's killed; workers is the number of worker threads, 0 for one per core
+int run_server(const char *address, const char *config_file, int workers){
+    raise_file_limit();
+    srand(time(NULL));
 
-    int movement = getch();
-    if (movement == 'q') {
-        return false;
+    Server *server = new Server;
+    server->level = new GameConfig();
+    if(strlen(config_file) >= sizeof(server->level->file_name)){
+        std::cerr << "The name of the config file is too long.\n";
+        return 1;
     }
-    else if (movement == 'i' && frog->is_carried == false){
-        frog_gets_in_the_car(game_config, frog, friendly_car);
-        frog->frogs_car = friendly_car;
+    strcpy(server->level->file_name, config_file);
+    if(load_level(server->level, &server->level_frog, server->roads_pos) == false){
+        std::cerr << "Somethings wrong with the given data in the config file.\n" << server->level->error << "\n";
+        return 1;
     }
-    else if(movement == 'o'){
-        frog_gets_out_of_the_car(game_config, frog);
+    server->level->rng = rand();
+    GameConfig *level = server->level;
+    //a client gets the board once, when it connects, so it can't follow a board that scrolls
+    if(level->endless == true){
+        std::cerr << "Endless levels can't be played on the server.\n";
+        return 1;
     }
-    else{
-        frogs_move(game_config, frog, movement);
+    server->entity_count = 1 + level->car_number + level->stork_count;
+    int level_bytes = sizeof(NetHeader) + sizeof(NetLevel) + level->width * level->height;
+    int frame_bytes = sizeof(NetHeader) + sizeof(NetFrame) + server->entity_count * sizeof(NetDelta);
+    server->max_message = level_bytes > frame_bytes ? level_bytes : frame_bytes;
+    if(server->max_message > NET_BUFFER){
+        std::cerr << "The level has too many cars for the server.\n";
+        return 1;
     }
-    
-    cars_move(game_config, cars, frog, roads_pos, cars_on_lane, free_lanes, lane_directions);
-    move_stork(game_config, stork, frog);
-    update_invincibility(frog);
 
-                        //drawing
-    //clear();
-    draw_board(game_window, game_config);
-    if(frog->is_carried == false){
-        draw_frog(game_window, frog);
+    server->session_count = MAX_SESSIONS;
+    server->sessions = new Session[MAX_SESSIONS];
+    for(int i = 0; i < MAX_SESSIONS; i++){
+        server->sessions[i].state.store(SESSION_FREE);
+        server->sessions[i].generation = 0;
+    }
+    server->listener = open_socket(address, true);
+    if(server->listener < 0){
+        perror(address);
+        return 1;
+    }
+    fcntl(server->listener, F_SETFL, fcntl(server->listener, F_GETFL) | O_NONBLOCK);
+    server->epoll = epoll_create1(0);
+    struct epoll_event listening;
+    listening.events = EPOLLIN;
+    listening.data.u64 = 0;
+    epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->listener, &listening);
+
+    server->steps.store(0);
+    server->step_time.store(0);
+    server->bytes_sent.store(0);
+    server->running.store(true);
+    server->worker_count = workers > 0 ? workers : std::thread::hardware_concurrency();
+    if(server->worker_count < 1){
+        server->worker_count = 1;
+    }
+    server->workers = new std::thread[server->worker_count];
+    for(int i = 0; i < server->worker_count; i++){
+        server->workers[i] = std::thread(serve_sessions, server, i);
+    }
+    fprintf(stderr, "serving %s on %s with %d workers\n", config_file, address, server->worker_count);
+
+    struct epoll_event events[64];
+    clock_t next_report = game_clock() + SERVER_REPORT_TIME * CLOCKS_PER_SEC / 1000;
+    for(;;){
+        int count = epoll_wait(server->epoll, events, 64, 100);
+        for(int i = 0; i < count; i++){
+            if(events[i].data.u64 == 0){
+                int fd;
+                while((fd = accept(server->listener, NULL, NULL)) >= 0){
+                    if(open_session(server, fd) == false){
+                        close(fd);      //no free session
+                    }
+                }
+                continue;
+            }
+            Session *session = &server->sessions[(events[i].data.u64 & 0xFFFFFFFF) - 1];
+            //an event of a closed connection whose slot has been opened again meanwhile is left alone
+            if(session->state.load(std::memory_order_acquire) != SESSION_RUNNING || session->generation != events[i].data.u64 >> 32){
+                continue;
+            }
+            read_session(session);
+            if(events[i].events & (EPOLLHUP | EPOLLERR)){
+                mark_session_closing(session);
+            }
+        }
+        if(game_clock() >= next_report){
+            report_server(server, SERVER_REPORT_TIME / 1000);
+            next_report += SERVER_REPORT_TIME * CLOCKS_PER_SEC / 1000;
+        }
     }
-    draw_cars(game_window, cars, game_config);
-    draw_status(game_config, frog, time_elapsed);
-    draw_stork(game_window, stork);
-    return true;
 }
 
-char game_play(WINDOW* game_window, GameConfig* game_config, Frog* frog, Car *cars, Car** frogs_car, Stork *stork, clock_t start_time, int roads_pos[], int cars_on_lane[], int *free_lanes, int lane_directions[]) {
-    for (;;) {
-        int time_elapsed = (clock() - start_time) / CLOCKS_PER_SEC;             //counting past time
-        if(game_update(game_window, game_config, frog, cars, stork, start_time, time_elapsed, roads_pos, cars_on_lane, free_lanes, lane_directions) == false){
-            return false;
-        }
 
-        if (check_game_status(game_window, game_config, frog, cars, stork, time_elapsed) != 'n') { //if game is won or lost, the function has to be finished executing
-            return false;
-        }
+            //CLIENTS - THE TERMINAL CLIENT AND THE LOAD GENERATOR
+void init_net_client(NetClient *client, int fd){
+    client->fd = fd;
+    client->in_length = 0;
+    client->board = NULL;
+    client->history = NULL;
+    client->entity_count = 0;
+    client->fresh = false;
+    client->frames = 0;
+    client->full_frames = 0;
+    client->bytes = 0;
+}
 
-        wrefresh(game_window);
-        delay(40); // Małe opóźnienie pętli
+void free_net_client(NetClient *client){
+    if(client->fd >= 0){
+        close(client->fd);
     }
+    delete[] client->board;
+    delete[] client->history;
 }
 
-//PREPARING TO START THE GAME
-
-bool initialize_game(GameConfig* game_config, Frog* frog) {
-    game_config->car_number = 1;
-    game_config->f_car_chance = 0;
-    game_config->n_car_chance = 0;
-    if (!start_game()) {
+//every size in the message is checked against its length before anything is copied, a bad one ends the connection
+bool client_level(NetClient *client, const char *message, int length){
+    NetLevel level;
+    if(length < (int)(sizeof(NetHeader) + sizeof(NetLevel))){
         return false;
     }
+    memcpy(&level, message + sizeof(NetHeader), sizeof(level));
+    if(level.width < 1 || level.width > MAX_NUM || level.height < 1 || level.height > MAX_NUM || level.entity_count < 1){
+        return false;
+    }
+    if(length != (int)(sizeof(NetHeader) + sizeof(NetLevel)) + level.width * level.height){
+        return false;
+    }
+    if(level.entity_count > (int)((NET_BUFFER - sizeof(NetHeader) - sizeof(NetFrame)) / sizeof(NetDelta))){
+        return false;           //the server never sends a level whose full frame doesn't fit in a message
+    }
+    client->width = level.width;
+    client->height = level.height;
+    client->entity_count = level.entity_count;
+    delete[] client->board;
+    delete[] client->history;
+    client->board = new char[level.width * level.height];
+    memcpy(client->board, message + sizeof(NetHeader) + sizeof(NetLevel), level.width * level.height);
+    client->history = new NetEntity[NET_HISTORY * level.entity_count];
     return true;
 }
 
-void setup_roads(GameConfig* game_config, int roads_pos[]) {
-    int temp = 0;
-    for (int i = 0; i < game_config->height; i++) {
-        if (game_config->board[i][0] == 'R') {
-            roads_pos[temp] = i;
-            temp++;
-            i++;
+//the frame is the acked base with the deltas put on top of it
+bool client_frame(NetClient *client, const char *message, int length){
+    NetFrame frame;
+    if(length < (int)(sizeof(NetHeader) + sizeof(NetFrame))){
+        return false;
+    }
+    memcpy(&frame, message + sizeof(NetHeader), sizeof(frame));
+    if(frame.frame < 0 || frame.base < -1 || frame.base > frame.frame || frame.count < 0 || frame.count > client->entity_count){
+        return false;
+    }
+    if(length != (int)(sizeof(NetHeader) + sizeof(NetFrame) + frame.count * sizeof(NetDelta))){
+        return false;
+    }
+    if(client->history == NULL){
+        return true;
+    }
+    int entity_count = client->entity_count;
+    NetEntity *entities = &client->history[(frame.frame % NET_HISTORY) * entity_count];
+    if(frame.base < 0){
+        memset(entities, 0, entity_count * sizeof(NetEntity));
+        for(int id = 0; id < entity_count; id++){
+            entities[id].sprite = NET_NONE;
         }
+        client->full_frames++;
+    }
+    else{
+        memcpy(entities, &client->history[(frame.base % NET_HISTORY) * entity_count], entity_count * sizeof(NetEntity));
     }
-}
 
-int* setup_cars_on_lane(GameConfig* game_config) {
-    int* cars_on_lane = new int[game_config->road_lanes];
-    for (int i = 0; i < game_config->road_lanes; i++) {
-        cars_on_lane[i] = 0;
+    const char *deltas = message + sizeof(NetHeader) + sizeof(NetFrame);
+    for(int i = 0; i < frame.count; i++){
+        NetDelta delta;
+        memcpy(&delta, deltas + i * sizeof(NetDelta), sizeof(delta));
+        if(delta.id < entity_count){
+            entities[delta.id] = delta.entity;
+        }
     }
-    return cars_on_lane;
+    client->last = frame;
+    client->fresh = true;
+    client->frames++;
+    send_message(client->fd, NET_ACK, frame.frame);
+    return true;
 }
 
-int* setup_lane_directions(GameConfig* game_config) {
-    int* lane_directions = new int[game_config->road_lanes];
-    for (int i = 0; i < game_config->road_lanes; i++) {
-        if(rand() % 2 == 0){
-            lane_directions[i] = 1;
+//takes everything the server has sent so far, false once the server is gone
+bool client_receive(NetClient *client){
+    for(;;){
+        int count = recv(client->fd, client->in + client->in_length, NET_BUFFER - client->in_length, MSG_DONTWAIT);
+        if(count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)){
+            return true;
         }
-        else {
-            lane_directions[i] = -1;
+        if(count <= 0){
+            return false;
+        }
+        client->bytes += count;
+        client->in_length += count;
+
+        int start = 0;
+        while(client->in_length - start >= (int)sizeof(NetHeader)){
+            NetHeader header;
+            memcpy(&header, client->in + start, sizeof(header));
+            if(header.length < (int)sizeof(NetHeader) || header.length > NET_BUFFER){
+                return false;
+            }
+            if(client->in_length - start < header.length){
+                break;
+            }
+            if(header.type == NET_LEVEL && client_level(client, client->in + start, header.length) == false){
+                return false;
+            }
+            else if(header.type == NET_FRAME && client_frame(client, client->in + start, header.length) == false){
+                return false;
+            }
+            start += header.length;
         }
+        memmove(client->in, client->in + start, client->in_length - start);
+        client->in_length -= start;
     }
-    return lane_directions;
 }
 
-void cleanup_game(Frog* frog, Car* cars, Stork *stork, int* cars_on_lane, int* lane_directions) {
-    delete frog;
-    delete[] cars;
-    delete[] cars_on_lane;
-    delete[] lane_directions;
-    delete[] stork;
-    endwin();
+//a frame that came from another process: the board as field letters and the entities
+void draw_remote_frame(WINDOW *game_window, const char *board, int width, int height, NetEntity entities[], int entity_count){
+    box(game_window, 0, 0);
+    chtype line[MAX_NUM];
+    for(int i = 0; i < height; i++){
+        for(int j = 0; j < width; j++){
+            line[j] = field_cell(board[i * width + j]);
+        }
+        mvwaddchnstr(game_window, i + 1, 1, line, width);
+    }
+    for(int id = 0; id < entity_count; id++){
+        if(entities[id].sprite < SPRITE_COUNT){
+            blit_sprite(game_window, entities[id].sprite, entities[id].y, entities[id].x);
+        }
+    }
 }
 
-//CREATING THE MENU PAGE
+void draw_net_frame(WINDOW *game_window, NetClient *client, char result, bool show_result){
+    NetEntity *entities = &client->history[(client->last.frame % NET_HISTORY) * client->entity_count];
+    draw_remote_frame(game_window, client->board, client->width, client->height, entities, client->entity_count);
+    if(show_result == true){
+        const char *text = result == 'w' ? "YOU WON!" : result == 'c' ? "GAME OVER!  YOU LOST!" : "GAME OVER!  STORK GOT YOU!";
+        mvwprintw(game_window, client->height / 2, client->width / 2 - 11, "%s", text);
+    }
 
-void display_menu() {
-    clear();
-    mvprintw(5, 10, "___=== Game Menu ===___");
-    mvprintw(6, 10, "1. Start Game");
-    mvprintw(7, 10, "2. Show Leaderboard");
-    mvprintw(8, 10, "3. Game Rules");
-    mvprintw(9, 10, "4. Exit");
-    mvprintw(11, 10, "Choose an option from 1 to 4:");
-    refresh();
+    attron(COLOR_PAIR(4));
+    mvprintw(client->height + 2, 0, "Ruchy: %d | Czas: %ds | Ramki: %lld (pelne: %lld) | %lld B", client->last.moves, client->last.time_elapsed, client->frames, client->full_frames, client->bytes);
+    attroff(COLOR_PAIR(4));
+    wnoutrefresh(stdscr);
+    wnoutrefresh(game_window);
+    doupdate();
 }
 
-void show_levels() {
-    clear();
-    mvprintw(5, 10, "___=== Select Difficulty ===___");
-    mvprintw(6, 10, "1. Easy level");
-    mvprintw(7, 10, "2. Medium level");
-    mvprintw(8, 10, "3. Difficult level");
-    mvprintw(10, 10, "Choose an option from 1 to 3:");
-    refresh();
+//draws what the server sends and sends it the keys, q leaves
+int run_client(const char *address){
+    int fd = open_socket(address, false);
+    if(fd < 0){
+        perror(address);
+        return 1;
+    }
+    start_game();
+    NetClient *client = new NetClient;
+    init_net_client(client, fd);
+    WINDOW *game_window = NULL;
+    char result = 'n';
+    clock_t result_until = 0;
+
+    bool running = true;
+    while(running){
+        struct pollfd server = {fd, POLLIN, 0};
+        poll(&server, 1, FRAME_TIME);
+        if(client_receive(client) == false){
+            break;
+        }
+        int key;
+        while((key = getch()) != ERR){
+            if(key == 'q'){
+                running = false;
+            }
+            send_message(fd, NET_KEY, key);
+        }
+        if(client->fresh == true && client->board != NULL){
+            if(game_window == NULL){
+                game_window = newwin(client->height + 2, client->width + 2, 0, 0);
+            }
+            if(client->last.status != 'n'){
+                result = client->last.status;
+                result_until = game_clock() + 2 * CLOCKS_PER_SEC;
+            }
+            draw_net_frame(game_window, client, result, game_clock() < result_until);
+            client->fresh = false;
+        }
+    }
+
+    if(game_window != NULL){
+        delwin(game_window);
+    }
+    endwin();
+    free_net_client(client);
+    delete client;
+    return 0;
 }
 
-bool handle_level_choice(int choice, char config_file_name[]) {
-    switch (choice) {
-        case 1: // Name of the easy level config file
-            strcpy(config_file_name, "config_easy.txt");
-            return true;
-        case 2: // -=- medium
-            strcpy(config_file_name, "config_medium.txt");
-            return true;
-        case 3: // -=- difficult
-            strcpy(config_file_name, "config_difficult.txt");
-            return true;
-        default:
+            //VIEWER - WATCHES A GAME STARTED WITH --broadcast
+//copies the newest frame; false if there is none yet or the game kept writing into it
+bool read_spectator_frame(SpectatorRing *ring, SpectatorSlot *copy, int *frame){
+    for(int attempt = 0; attempt < SPECTATOR_SLOTS; attempt++){
+        int newest = ring->newest.load(std::memory_order_acquire);
+        if(newest < 0){
             return false;
-            refresh();
-            getch();
+        }
+        SpectatorSlot *slot = &ring->slots[newest % SPECTATOR_SLOTS];
+        unsigned int before = slot->sequence.load(std::memory_order_acquire);
+        if(before & 1){
+            continue;
+        }
+        copy->level = slot->level;
+        copy->moves = slot->moves;
+        copy->time_elapsed = slot->time_elapsed;
+        copy->count = slot->count < SPECTATOR_ENTITIES ? slot->count : SPECTATOR_ENTITIES;
+        memcpy(copy->entities, slot->entities, copy->count * sizeof(NetEntity));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot->sequence.load(std::memory_order_relaxed) == before){
+            *frame = newest;
+            return true;
+        }
     }
     return false;
 }
 
-void print_game_rules(){
-    clear();
-    mvprintw(5, 10, "___=== Game Rules ===___");
-    mvprintw(6, 10, "1) Move with arrows;");
-    mvprintw(7, 10, "2) Red cars are hostile ones;");
-    mvprintw(8, 10, "3) Yellow cars are neutral, they will wait for you to pass them by;");
-    mvprintw(9, 10, "4) Same with blue cars, but they can also take you to another place");
-    mvprintw(10, 10, "\t4.1) If you want to hop into a car you need to press 'i'");
-    mvprintw(11, 10, "\t\ton your keyboard when you are close to them. Your car turns green.");
-    mvprintw(12, 10, "\t4.2) In order to get out of the car you need to press 'o';");
-    mvprintw(13, 10, "5) If you want to quit the game press 'q'.");
-    mvprintw(15, 10, "Press anything to get back to the main menu.");
-    refresh();
+bool read_spectator_board(SpectatorRing *ring, char board[], int *level, int *width, int *height){
+    unsigned int before = ring->board_sequence.load(std::memory_order_acquire);
+    if(before & 1){
+        return false;
+    }
+    *level = ring->level;
+    *width = ring->width < MAX_NUM ? ring->width : MAX_NUM;
+    *height = ring->height < MAX_NUM ? ring->height : MAX_NUM;
+    memcpy(board, ring->board, *width * *height);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return ring->board_sequence.load(std::memory_order_relaxed) == before;
 }
-char handle_menu_choice(int choice, char config_file_name[]) { 
-    switch (choice) {
-        case 1: {
-            int level_choice;
-            show_levels();
-            level_choice = getch() - '0';
-            if (handle_level_choice(level_choice, config_file_name) == true) {
-                return 's';
-            }
-            break;
+
+//only reads the shared memory, so any number of viewers can watch and none of them can slow the game down
+int run_viewer(const char *name){
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0){
+        perror(name);
+        return 1;
+    }
+    void *memory = mmap(NULL, sizeof(SpectatorRing), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED || ((SpectatorRing*)memory)->magic != SPECTATOR_MAGIC){
+        std::cerr << "Nothing is broadcast as " << name << ".\n";
+        return 1;
+    }
+    SpectatorRing *ring = (SpectatorRing*)memory;
+
+    start_game();
+    SpectatorSlot *frame = new SpectatorSlot;
+    char board[MAX_NUM * MAX_NUM];
+    int level = -1, width = 0, height = 0;
+    int last_frame = -1, frame_number;
+    WINDOW *game_window = NULL;
+    while(getch() != 'q' && ring->open.load(std::memory_order_acquire) == true){
+        delay(FRAME_TIME);
+        if(read_spectator_frame(ring, frame, &frame_number) == false || frame_number == last_frame){
+            continue;
         }
-        case 2:
+        if(frame->level != level){
+            int board_level;
+            if(read_spectator_board(ring, board, &board_level, &width, &height) == false || board_level != frame->level){
+                continue;
+            }
+            level = board_level;
+            if(game_window != NULL){
+                delwin(game_window);
+            }
             clear();
-            show_ranking();
-            refresh();
-            getch();
-            break;
-        case 3:
-            print_game_rules();
-            getch();
-            break;
-        case 4:
-            return 'e';
-        default:
-            mvprintw(12, 10, "Invalid choice, pick a number from 1 to 4.");
-            refresh();
-            getch();
+            game_window = newwin(height + 2, width + 2, 0, 0);
+        }
+        last_frame = frame_number;
+        draw_remote_frame(game_window, board, width, height, frame->entities, frame->count);
+        attron(COLOR_PAIR(4));
+        mvprintw(height + 2, 0, "Widz | Ruchy: %d | Czas: %ds | Ramka: %d", frame->moves, frame->time_elapsed, frame_number);
+        attroff(COLOR_PAIR(4));
+        wnoutrefresh(stdscr);
+        wnoutrefresh(game_window);
+        doupdate();
     }
-    return 'n';
-}
-
-int play(GameConfig *game_config) {
-    Frog* frog = new Frog;
-    Stork *stork = new Stork;
-    game_config->car_number = 1;
-    stork->alive = false;
 
-    if (read_config(game_config, frog, stork) == false) {
-        return 0;
+    if(game_window != NULL){
+        delwin(game_window);
     }
+    endwin();
+    delete frame;
+    munmap(ring, sizeof(SpectatorRing));
+    return 0;
+}
 
-    int roads_pos[MAX_NUM] = {0};
-    setup_roads(game_config, roads_pos);
-
-    int* cars_on_lane = setup_cars_on_lane(game_config);
-    int free_lanes = game_config->road_lanes;
-    int* lane_directions = setup_lane_directions(game_config);
-
-    Car *cars = new Car[game_config->car_number];
-    Car *frogs_car = NULL;
-    init_frog(game_config, frog);
-    init_cars(cars, game_config, roads_pos, cars_on_lane, &free_lanes, lane_directions);
-    init_stork(game_config, stork, frog);
+//opens many sessions that play like a lazy player (about one arrow a second) and checks what comes back
+int run_load_test(const char *address, int session_count, int seconds){
+    raise_file_limit();
+    NetClient *clients = new NetClient[session_count];
+    int epoll = epoll_create1(0);
+    for(int i = 0; i < session_count; i++){
+        int fd = open_socket(address, false);
+        if(fd < 0){
+            fprintf(stderr, "only %d sessions could connect\n", i);
+            session_count = i;
+            break;
+        }
+        init_net_client(&clients[i], fd);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    }
 
-    clock_t start_time = clock(); //Time of the beginning of the game
-    clock_t last_move_time = clock();
-    WINDOW* game_window = newwin(game_config->height + 2, game_config->width + 2, 0, 0); 
+    const int arrows[4] = {KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT};
+    int open = session_count;
+    clock_t end = game_clock() + (clock_t)seconds * CLOCKS_PER_SEC;
+    struct epoll_event events[256];
+    while(game_clock() < end && open > 0){
+        int count = epoll_wait(epoll, events, 256, 100);
+        for(int i = 0; i < count; i++){
+            NetClient *client = &clients[events[i].data.u32];
+            if(client->fd < 0){
+                continue;
+            }
+            if(client_receive(client) == false){
+                epoll_ctl(epoll, EPOLL_CTL_DEL, client->fd, NULL);
+                close(client->fd);
+                client->fd = -1;
+                open--;
+                continue;
+            }
+            if(client->fresh == true){
+                client->fresh = false;
+                if(rand() % (1000 / FRAME_TIME) == 0){
+                    send_message(client->fd, NET_KEY, arrows[rand() % 4]);
+                }
+            }
+        }
+    }
 
-    if (game_play(game_window, game_config, frog, cars, &frogs_car, stork, start_time, roads_pos, cars_on_lane, &free_lanes, lane_directions) == false) {
-        cleanup_game(frog, cars, stork, cars_on_lane, lane_directions);    
+    long long frames = 0, full_frames = 0, bytes = 0;
+    for(int i = 0; i < session_count; i++){
+        frames += clients[i].frames;
+        full_frames += clients[i].full_frames;
+        bytes += clients[i].bytes;
+        free_net_client(&clients[i]);
     }
-    return 1;
+    close(epoll);
+    delete[] clients;
+
+    printf("sessions: %d (%d still open)\n", session_count, open);
+    printf("frames: %lld, %.1f per second per session, %lld of them full\n", frames, session_count > 0 ? frames / (double)seconds / session_count : 0.0, full_frames);
+    printf("received: %lld bytes, %.1f per frame\n", bytes, frames > 0 ? bytes / (double)frames : 0.0);
+    return 0;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    //--metrics ADDRESS can follow any mode, it's taken out before the mode reads its arguments
+    for(int i = 1; i + 1 < argc; i++){
+        if(strcmp(argv[i], "--metrics") == 0){
+            if(start_metrics(argv[i + 1]) == false){
+                perror(argv[i + 1]);
+                return 1;
+            }
+            for(int j = i; j + 2 <= argc; j++){
+                argv[j] = argv[j + 2];
+            }
+            argc -= 2;
+            break;
+        }
+    }
+    if(argc > 1 && strcmp(argv[1], "--bench-state") == 0){
+        return bench_state(argc > 2 ? atoi(argv[2]) : 10000);
+    }
+    if(argc > 4 && strcmp(argv[1], "--tune") == 0){
+        return run_tuner(argv[2], atof(argv[3]), atof(argv[4]), argc > 5 ? argv[5] : NULL);
+    }
+    if(argc > 2 && strcmp(argv[1], "--read-log") == 0){
+        return read_event_log(argv[2], argc > 3 ? argv[3] : NULL);
+    }
+    if(argc > 1 && strcmp(argv[1], "--bench-log") == 0){
+        return bench_event_log(argc > 2 ? atoll(argv[2]) : BENCH_EVENTS);
+    }
+    if(argc > 3 && strcmp(argv[1], "--crowd") == 0){
+        return run_crowd(argv[2], atoi(argv[3]), argc > 4 ? atoi(argv[4]) : 10, argc > 5 ? argv[5] : NULL);
+    }
+    if(argc > 1 && strcmp(argv[1], "--check-collisions") == 0){
+        return check_collisions();
+    }
+    if(argc > 1 && strcmp(argv[1], "--bench-board") == 0){
+        return bench_board(argc > 3 ? atoi(argv[2]) : 10000, argc > 3 ? atoi(argv[3]) : 10000);
+    }
+    if(argc > 3 && strcmp(argv[1], "--server") == 0){
+        return run_server(argv[2], argv[3], argc > 4 ? atoi(argv[4]) : 0);
+    }
+    if(argc > 2 && strcmp(argv[1], "--client") == 0){
+        return run_client(argv[2]);
+    }
+    if(argc > 4 && strcmp(argv[1], "--load-test") == 0){
+        return run_load_test(argv[2], atoi(argv[3]), atoi(argv[4]));
+    }
+    if(argc > 2 && strcmp(argv[1], "--watch") == 0){
+        return run_viewer(argv[2]);
+    }
     start_game(); //getting pdcurses to work
 
     GameConfig *game_config = new GameConfig;
+    game_config->output = OUTPUT_CURSES;
+    game_config->frame_budget = FRAME_TIME;
+    game_config->spectators = NULL;
+    const char *broadcast_name = NULL;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--ansi") == 0){
+            game_config->output = OUTPUT_ANSI;      //for slow remote terminals
+        }
+        else if(strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc){
+            game_config->frame_budget = atoi(argv[++i]);      //ms, 16 for 60 frames a second
+            if(game_config->frame_budget < 1){
+                game_config->frame_budget = FRAME_TIME;
+            }
+        }
+        else if(strcmp(argv[i], "--event-log") == 0 && i + 1 < argc){
+            if(open_event_log(argv[++i]) == false){
+                endwin();
+                perror(argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--broadcast") == 0 && i + 1 < argc){
+            broadcast_name = argv[++i];
+            game_config->spectators = open_spectator_ring(broadcast_name);
+            if(game_config->spectators == NULL){
+                endwin();
+                perror(broadcast_name);
+                return 1;
+            }
+        }
+    }
+    game_config->scores = new ScoreWriter;
+    start_score_writer(game_config->scores);
     char config_file_name[MAX_NUM];
+    Arena arena;
+    init_arena(&arena, ARENA_START_SIZE);
+    LevelCache *level_cache = new LevelCache;
+    start_level_cache(level_cache);
 
     nodelay(stdscr, FALSE); //getch waits for the users input
     while (true) {
         display_menu();
         int choice = getch() - '0';
-        char action = handle_menu_choice(choice, config_file_name);
+        char action = handle_menu_choice(choice, config_file_name, game_config->scores);
         if (action == 'e') {
+            if(game_config->spectators != NULL){
+                close_spectator_ring(game_config->spectators, broadcast_name);
+            }
+            if(event_log != NULL){
+                close_event_log();
+            }
+            stop_score_writer(game_config->scores);
+            delete game_config->scores;
             delete game_config;
+            if(metrics != NULL){
+                stop_metrics();
+            }
+            free_arena(&arena);
+            stop_level_cache(level_cache);
+            delete level_cache;
             break;
         }
         else if(action == 's'){
             nodelay(stdscr, TRUE); //now the program works without the need of intervention from the player 
             strcpy(game_config->file_name, config_file_name);
-            if(play(game_config) == 0){
-                std::cerr << "Somethings wrong with the given data in the config file.";
+            if(play(game_config, &arena, level_cache) == 0){
+                show_config_error(game_config);
             }
             nodelay(stdscr, FALSE); //again, now program waits for the users input
         }